@@ -4,18 +4,24 @@ layout(location = 0) in vec3 posObj;
 layout(location = 1) in vec3 nObj;
 layout(location = 2) in vec2 uv;
 
-uniform mat4 model;
-uniform mat4 normalModel;
-uniform mat4 view;
-uniform mat4 proj;
-
-uniform int numLights;
-uniform mat4 lightMVPs[8];
+// Per-instance attributes (one draw per group of identical meshes)
+layout(location = 3)  in mat4 model;        // 3..6
+layout(location = 7)  in mat3 normalModel;  // 7..9
+layout(location = 10) in int  material;
+layout(location = 11) in int  instance;     // index of this instance's light list
+
+// Per-frame blocks (std140, filled once per frame by Realtime)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+};
 
 out vec3 posWorld;          // your fragment shader expects this
 out vec3 normWorld;         // your fragment shader expects this
-out vec4 posLightSpace[8];  // required for soft shadow code
 out vec2 uvOut;
+flat out int materialId;
+flat out int instanceId;
 
 void main()
 {
@@ -24,13 +30,10 @@ void main()
     posWorld = pw.xyz;
 
     // World-space normal
-    normWorld = normalize(mat3(normalModel) * nObj);
-
-    // Shadow mapping coordinates
-    for (int i = 0; i < numLights; i++) {
-        posLightSpace[i] = lightMVPs[i] * pw;
-    }
+    normWorld = normalize(normalModel * nObj);
 
     gl_Position = proj * view * pw;
     uvOut = uv;
+    materialId = material;
+    instanceId = instance;
 }
@@ -0,0 +1,57 @@
+#version 330 core
+
+// Lighting pass of the deferred path: one full-screen quad (texture.vert)
+// that rebuilds each pixel's surface from the G-buffer and runs the same
+// clustered light loop as default.frag
+
+in vec2 uv;
+
+uniform sampler2D gAlbedo;
+uniform usampler2D gNormalMaterial;
+uniform sampler2D gDepth;
+uniform mat4 invViewProj;   // clip -> world
+
+// Per-shape materials, 3 texels each: (ka, shininess), (kd, -), (ks, -)
+uniform samplerBuffer materials;
+
+out vec4 fragColor;
+
+#include "lighting.glsl"
+
+vec3 decodeOctahedral(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(gDepth, texel, 0).r;
+
+    vec4 world = invViewProj * vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec3 P = world.xyz / world.w;
+
+    // Taken before any pixel leaves, like default.frag's; they span depth
+    // edges here, which only softens EVSM lookups along silhouettes
+    dPosdx = dFdx(P);
+    dPosdy = dFdy(P);
+
+    // Nothing drawn here: keep the cleared background
+    if (depth >= 1.0) discard;
+
+    // Depth for anything drawn after the lighting pass (camera trace)
+    gl_FragDepth = depth;
+
+    uvec4 surface = texelFetch(gNormalMaterial, texel, 0);
+    vec3 N = decodeOctahedral(vec2(surface.xy) / 65535.0);
+    int materialId = int(surface.z | (surface.w << 16));
+
+    vec4 m0 = texelFetch(materials, materialId * 3);
+    vec3 ks = texelFetch(materials, materialId * 3 + 2).rgb;
+    vec3 albedo = texelFetch(gAlbedo, texel, 0).rgb;
+
+    fragColor = vec4(m0.rgb + shadeLights(P, N, albedo, ks, m0.a), 1.0);
+}
@@ -0,0 +1,73 @@
+#version 330 core
+
+// Geometry pass of the deferred path: default.vert's outputs packed into
+// the G-buffer, lit later by deferred.frag
+
+in vec3 posWorld;
+in vec3 normWorld;
+in vec2 uvOut;
+flat in int materialId;
+
+// Permutation defines: USE_TEXTURE, USE_BUMP (as in default.frag)
+
+#ifdef USE_TEXTURE
+uniform sampler2D sampler;
+#endif
+
+// ---------------- BUMP MAPPING ----------------
+#ifdef USE_BUMP
+uniform sampler2D heightMap;
+uniform float bumpScale;
+#endif
+
+// Per-shape materials, 3 texels each: (ka, shininess), (kd, -), (ks, -)
+uniform samplerBuffer materials;
+
+layout(location = 0) out vec4 gAlbedo;          // RGBA8: diffuse albedo
+layout(location = 1) out uvec4 gNormalMaterial; // RGBA16UI: octahedral normal, material slot (low, high 16 bits)
+
+// Same perturbation as default.frag
+vec3 applyBump(vec3 normal, vec3 dpdx)
+{
+#ifndef USE_BUMP
+    return normal;
+#else
+    if (bumpScale <= 0.0)
+        return normal;
+
+    float hC  = texture(heightMap, uvOut).r;
+    float hR  = texture(heightMap, uvOut + vec2(1.0/2048.0, 0)).r;
+    float hU  = texture(heightMap, uvOut + vec2(0, 1.0/2048.0)).r;
+
+    vec3 T = normalize(dpdx);
+    vec3 B = normalize(cross(normal, T));
+
+    return normalize(normal + bumpScale * (hR - hC) * T + bumpScale * (hU - hC) * B);
+#endif
+}
+
+// Unit vector -> [0,1]^2 on the octahedron, folded over for the lower hemisphere
+vec2 encodeOctahedral(vec3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0.0) e = (1.0 - abs(n.yx)) * vec2(e.x >= 0.0 ? 1.0 : -1.0, e.y >= 0.0 ? 1.0 : -1.0);
+    return e * 0.5 + 0.5;
+}
+
+void main()
+{
+    vec3 dpdx = dFdx(posWorld);
+
+    vec3 N = applyBump(normalize(normWorld), dpdx);
+    vec3 kd = texelFetch(materials, materialId * 3 + 1).rgb;
+
+#ifdef USE_TEXTURE
+    gAlbedo = vec4(texture(sampler, uvOut).rgb, 1.0);
+#else
+    gAlbedo = vec4(kd, 1.0);
+#endif
+    // Material slot split across two 16-bit channels (low, high)
+    uint slot = uint(materialId);
+    gNormalMaterial = uvec4(uvec2(round(encodeOctahedral(N) * 65535.0)), slot & 0xFFFFu, slot >> 16);
+}
@@ -0,0 +1,329 @@
+// Clustered light loop and shadow lookups shared by default.frag (forward)
+// and deferred.frag (full-screen pass). Included after #version; the
+// including shader sets dPosdx/dPosdy in main() before shading.
+//
+// Permutation defines (see shaderpermutations.cpp):
+//   SHADOWS, SHADOWED_LIGHTS n   shadow array lookups for the first n lights
+//   EVSM                         prefiltered moments instead of PCF
+//   HAS_POINT, HAS_DIRECTIONAL,
+//   HAS_SPOT                     light types present in the scene
+
+// Per-frame blocks (std140, filled once per frame by Realtime)
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 proj;
+    vec4 cameraPos;
+};
+
+struct Light {
+    vec4  color;     // rgb
+    vec4  pos;       // xyz, world space
+    vec4  dir;       // xyz, world space, normalized
+    vec4  function;  // xyz attenuation coefficients
+    int   type;
+    float angle;
+    float penumbra;
+    float range;     // attenuation below the cutoff past this (0 = unbounded)
+};
+
+// Clustered lights: every light in a table, plus per-cluster index lists
+uniform samplerBuffer lightData;       // 5 texels per light (see LightRecord)
+uniform usamplerBuffer clusterRanges;  // per cluster: first index, count
+uniform usamplerBuffer clusterLights;  // light indices, grouped by cluster
+uniform ivec3 clusterGrid;
+uniform vec2 clusterScale;             // clusters per pixel along x and y
+uniform vec2 clusterDepth;             // slice = log(depth) * x - y
+
+Light fetchLight(int i)
+{
+    Light L;
+    L.color    = texelFetch(lightData, i * 5);
+    L.pos      = texelFetch(lightData, i * 5 + 1);
+    L.dir      = texelFetch(lightData, i * 5 + 2);
+    L.function = texelFetch(lightData, i * 5 + 3);
+    vec4 p     = texelFetch(lightData, i * 5 + 4);
+    L.type     = int(p.x);
+    L.angle    = p.y;
+    L.penumbra = p.z;
+    L.range    = p.w;
+    return L;
+}
+
+// Screen-space derivatives of the shaded position, taken in main() where
+// control flow is still uniform
+vec3 dPosdx;
+vec3 dPosdy;
+
+#ifdef SHADOWS
+
+// Shadow layers: one per spot light, CASCADES per directional light,
+// six cube faces (+x -x +y -y +z -z) per point light
+const int CASCADES = 3;
+uniform mat4 lightMVPs[32];   // world -> light clip, per layer
+uniform vec4 layerRegions[32]; // per layer: uv corner (xy), rendered fraction (z), array slice (w)
+uniform int shadowLayers[SHADOWED_LIGHTS];     // first layer of each shadowed light (-1 = none)
+uniform vec4 layerPoints[32];  // per layer: point light position (xyz) and far (w) it was rendered with
+uniform vec4 cascadeSplits;   // view-space far distance of each cascade
+uniform int shadowSize;
+
+#ifdef EVSM
+// Prefiltered EVSM: blurred, mipmapped moments in the same layer layout
+uniform sampler2DArray shadowMoments;   // (e^cz, e^2cz, -e^-cz, e^-2cz)
+uniform vec2 evsmExponents;
+
+// Upper bound on the lit fraction from two moments, with the low tail cut
+// off to reduce light bleeding between overlapping casters
+float chebyshev(vec2 moments, float mean, float minVariance)
+{
+    if (mean <= moments.x) return 1.0;
+
+    float variance = max(moments.y - moments.x * moments.x, minVariance);
+    float d = mean - moments.x;
+    float pMax = variance / (variance + d * d);
+    return clamp((pMax - 0.2) / 0.8, 0.0, 1.0);
+}
+
+// Layer uv of a world position, within the layer's region of its slice
+vec2 shadowUV(int layer, vec3 p)
+{
+    vec4 clip = lightMVPs[layer] * vec4(p, 1.0);
+    vec4 region = layerRegions[layer];
+    return region.xy + (clip.xy / clip.w * 0.5 + 0.5) * region.z;
+}
+
+// One trilinear fetch; gradients come from the world-space derivatives so
+// mip selection stays defined inside this function's branches
+float varianceShadow(int layer, vec3 P, vec2 uv, float depth, vec2 texelMin, vec2 texelMax)
+{
+    vec2 dx = shadowUV(layer, P + dPosdx) - uv;
+    vec2 dy = shadowUV(layer, P + dPosdy) - uv;
+    vec4 m = textureGrad(shadowMoments, vec3(clamp(uv, texelMin, texelMax), layerRegions[layer].w), dx, dy);
+
+    float z = 2.0 * depth - 1.0;
+    vec2 warped = vec2(exp(evsmExponents.x * z), -exp(-evsmExponents.y * z));
+    vec2 minVariance = 0.0001 * evsmExponents * warped;
+    minVariance *= minVariance;
+
+    return min(chebyshev(m.xy, warped.x, minVariance.x),
+               chebyshev(m.zw, warped.y, minVariance.y));
+}
+
+#else
+uniform sampler2DArrayShadow shadowMaps;   // hardware compare, bilinear
+uniform int shadowTaps;       // 1, 4, 8 or 16 taps of the Poisson disk below
+
+// Poisson disk in the unit circle, ordered so that taps 0-3 and 4-7 each
+// cover all four quadrants
+const vec2 POISSON[16] = vec2[](
+    vec2(-0.94201624, -0.39906216), vec2( 0.94558609, -0.76890725),
+    vec2(-0.24188840,  0.99706507), vec2( 0.97484398,  0.75648379),
+    vec2(-0.09418410, -0.92938870), vec2( 0.34495938,  0.29387760),
+    vec2(-0.91588581,  0.45771432), vec2( 0.53742981, -0.47373420),
+    vec2(-0.81544232, -0.87912464), vec2(-0.38277543,  0.27676845),
+    vec2( 0.44323325, -0.97511554), vec2(-0.26496911, -0.41893023),
+    vec2( 0.79197514,  0.19090188), vec2(-0.81409955,  0.91437590),
+    vec2( 0.19984126,  0.78641367), vec2( 0.14383161, -0.14100790)
+);
+#endif
+
+
+// ======================================================
+// SAFE SHADOW FUNCTION
+// ======================================================
+float computeShadow(int i, Light Lgt, vec3 P, float bias)
+{
+    if (i >= SHADOWED_LIGHTS)
+        return 1.0;
+
+    int layer = shadowLayers[i];
+    if (layer < 0)
+        return 1.0;
+
+#ifdef HAS_DIRECTIONAL
+    // Directional lights: pick the cascade covering this fragment's depth
+    if (Lgt.type == 1) {
+        float viewDepth = -(view * vec4(P, 1.0)).z;
+        int cascade = 0;
+        while (cascade < CASCADES - 1 && viewDepth > cascadeSplits[cascade]) cascade++;
+        layer += cascade;
+    }
+#endif
+
+#ifdef HAS_POINT
+    // Point lights: the cube face is the direction's major axis, seen from
+    // where the faces were rendered (a deferred refresh may lag the light)
+    if (Lgt.type == 0) {
+        vec3 toFrag = P - layerPoints[layer].xyz;
+        vec3 a = abs(toFrag);
+        int face = (a.x >= a.y && a.x >= a.z) ? (toFrag.x > 0.0 ? 0 : 1)
+                 : (a.y >= a.z)               ? (toFrag.y > 0.0 ? 2 : 3)
+                 :                              (toFrag.z > 0.0 ? 4 : 5);
+        layer += face;
+    }
+#endif
+
+    vec4 posLS = lightMVPs[layer] * vec4(P, 1.0);
+    posLS /= posLS.w;
+
+    vec3 projCoords = posLS.xyz * 0.5 + 0.5;
+
+    if (projCoords.x < 0.0 || projCoords.x > 1.0 ||
+        projCoords.y < 0.0 || projCoords.y > 1.0 ||
+        projCoords.z > 1.0)
+    {
+        return 1.0;
+    }
+
+#ifdef HAS_POINT
+    // Point faces hold linear distance, not window depth
+    if (Lgt.type == 0) {
+        projCoords.z = length(P - layerPoints[layer].xyz) / layerPoints[layer].w;
+        if (projCoords.z > 1.0) return 1.0;
+    }
+#endif
+
+    float currentDepth = projCoords.z - bias;
+
+    // Lower-resolution layers only fill their lower-left corner; cascades
+    // a quadrant of their light's shared slice
+    vec4 region = layerRegions[layer];
+    float slice = region.w;
+    vec2 texelMin = region.xy + vec2(0.5 / shadowSize);
+    vec2 texelMax = region.xy + vec2(region.z - 0.5 / shadowSize);
+    projCoords.xy = region.xy + projCoords.xy * region.z;
+
+#ifdef EVSM
+    return varianceShadow(layer, P, projCoords.xy, currentDepth, texelMin, texelMax);
+#else
+    // Single tap: one bilinear 2x2 compare
+    if (shadowTaps <= 1) {
+        return texture(shadowMaps, vec4(clamp(projCoords.xy, texelMin, texelMax), slice, currentDepth));
+    }
+
+    // Rotated Poisson taps, 2 texels in radius; the per-pixel rotation
+    // turns banding into noise
+    float angle = 6.2831853 * fract(sin(dot(gl_FragCoord.xy, vec2(12.9898, 78.233))) * 43758.5453);
+    mat2 rotation = mat2(cos(angle), sin(angle), -sin(angle), cos(angle));
+    float radius = 2.0 / shadowSize;
+
+    float visibility = 0.0;
+    int taps = min(shadowTaps, 16);
+    for (int t = 0; t < taps; t++) {
+        vec2 uv = clamp(projCoords.xy + rotation * POISSON[t] * radius, texelMin, texelMax);
+        visibility += texture(shadowMaps, vec4(uv, slice, currentDepth));
+
+        // Fully lit or fully shadowed after the first four: the rest agree
+        if (t == 3 && (visibility < 0.001 || visibility > 3.999)) {
+            return visibility * 0.25;
+        }
+    }
+
+    return visibility / float(taps);
+#endif
+}
+
+#else
+float computeShadow(int i, Light Lgt, vec3 P, float bias)
+{
+    return 1.0;
+}
+#endif // SHADOWS
+
+
+// ======================================================
+// LIGHT LOOP
+// ======================================================
+
+// (first, count) of this pixel's cluster in clusterLights: screen tile,
+// exponential depth slice
+uvec2 clusterRange(vec3 P)
+{
+    float viewDepth = max(-(view * vec4(P, 1.0)).z, 1e-4);
+    ivec3 cell = ivec3(ivec2(gl_FragCoord.xy * clusterScale),
+                       int(floor(log(viewDepth) * clusterDepth.x - clusterDepth.y)));
+    cell = clamp(cell, ivec3(0), clusterGrid - 1);
+    int cluster = (cell.z * clusterGrid.y + cell.y) * clusterGrid.x + cell.x;
+    return texelFetch(clusterRanges, cluster).xy;
+}
+
+// Diffuse + specular of light i at P (zero outside its range or cone);
+// E points from P to the eye. Branches for light types the scene does
+// not have are compiled out.
+vec3 shadeLight(int i, vec3 P, vec3 N, vec3 E, vec3 albedo, vec3 ks, float shininess)
+{
+    Light Lgt = fetchLight(i);
+
+    vec3 L;
+    float attenuation = 1.0;
+
+#ifdef HAS_DIRECTIONAL
+    if (Lgt.type == 1) { // directional
+        L = normalize(-Lgt.dir.xyz);
+    }
+    else
+#endif
+    {
+#if defined(HAS_POINT) || defined(HAS_SPOT)
+        L = Lgt.pos.xyz - P;
+        float dist = length(L);
+        if (Lgt.range > 0.0 && dist > Lgt.range) return vec3(0.0);
+        L = normalize(L);
+
+        attenuation = 1.0 / (Lgt.function.x +
+                             dist * Lgt.function.y +
+                             dist * dist * Lgt.function.z);
+        attenuation = clamp(attenuation, 0.0, 1.0);
+#else
+        return vec3(0.0);
+#endif
+    }
+
+#ifdef HAS_SPOT
+    // Spot cutoff
+    if (Lgt.type == 2) {
+        vec3 spotDir = normalize(-Lgt.dir.xyz);
+        float angle = acos(dot(spotDir, L));
+        float outer = Lgt.angle;
+        float inner = outer - Lgt.penumbra;
+
+        if (angle > outer) return vec3(0.0);
+        else if (angle > inner) {
+            float t = (angle - inner) / (outer - inner);
+            float smo = -2.0*t*t*t + 3.0*t*t;
+            attenuation *= (1.0 - smo);
+        }
+    }
+#endif
+
+    float NdotL = max(dot(N, L), 0.0);
+    float bias = clamp(0.005 * tan(acos(NdotL)), 0.00001, 0.01);
+
+    float visibility = computeShadow(i, Lgt, P, bias);
+
+    // Diffuse
+    vec3 diffuse = albedo * NdotL;
+
+    // Specular
+    vec3 specular = vec3(0.0);
+    if (NdotL > 0.0) {
+        vec3 R = normalize(reflect(-L, N));
+        float RdotE = max(dot(R, E), 0.0);
+        specular = ks * pow(RdotE, shininess);
+    }
+
+    return visibility * attenuation * Lgt.color.rgb * (diffuse + specular);
+}
+
+// Every light of this pixel's cluster (ambient is left to the caller)
+vec3 shadeLights(vec3 P, vec3 N, vec3 albedo, vec3 ks, float shininess)
+{
+    vec3 E = normalize(cameraPos.xyz - P);
+    uvec2 lightRange = clusterRange(P);
+
+    vec3 illumination = vec3(0.0);
+    for (uint k = 0u; k < lightRange.y; k++) {
+        int i = int(texelFetch(clusterLights, int(lightRange.x + k)).r);
+        illumination += shadeLight(i, P, N, E, albedo, ks, shininess);
+    }
+    return illumination;
+}
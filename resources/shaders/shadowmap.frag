@@ -1,4 +1,17 @@
-#version 330 core
+#version 410 core
+
+// Permutation define: POINT_SHADOWS, for point light faces only. Writing
+// gl_FragDepth disables early depth tests, so spot and directional layers
+// use the variant without it and keep the rasterizer's depth.
+
+#ifdef POINT_SHADOWS
+in vec3 posWorld;
+flat in vec4 pointLight;
+#endif
 
 void main(){
+#ifdef POINT_SHADOWS
+        // Point light faces store linear distance so all six share one scale
+        gl_FragDepth = length(posWorld - pointLight.xyz) / pointLight.w;
+#endif
 }
@@ -1,10 +1,13 @@
-#version 330 core
+#version 410 core
 
-layout(location = 0) in vec3 posObj;
+layout(location = 0) in vec3 posObj;      // packed position-only stream
+layout(location = 3) in mat4 model;       // per-instance, 3..6
+layout(location = 7) in uint layerMask;   // per-instance, layers it may cover
 
-uniform mat4 model;
-uniform mat4 lightMVP;
+flat out uint casterLayers;
 
 void main() {
-        gl_Position = lightMVP * model * vec4(posObj, 1.0);
+        // World space; shadowmap.geom projects into each light
+        gl_Position = model * vec4(posObj, 1.0);
+        casterLayers = layerMask;
 }
@@ -0,0 +1,44 @@
+#version 330 core
+
+// EVSM prefilter, drawn over one shadow layer with texture.vert's quad.
+// The first pass warps raw depth into exponential moments and blurs along
+// x; the second blurs that result along y into the moments array.
+uniform sampler2DArray depthLayers;   // raw depths (compare mode off)
+uniform sampler2D blurSource;         // output of the first pass
+uniform bool fromDepth;
+uniform int layer;                    // array slice
+uniform ivec2 origin;                 // corner of the layer's region (cascades use a quadrant)
+uniform int region;                   // valid texels per axis (tiered layers fill a corner)
+uniform int blurRadius;
+uniform vec2 exponents;               // positive / negative warp
+
+out vec4 moments;
+
+vec4 warp(float depth) {
+    float z = 2.0 * depth - 1.0;
+    float pos =  exp( exponents.x * z);
+    float neg = -exp(-exponents.y * z);
+    return vec4(pos, pos * pos, neg, neg * neg);
+}
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 axis  = fromDepth ? ivec2(1, 0) : ivec2(0, 1);
+
+    // Gaussian with the radius at two standard deviations; the filtered
+    // lookup costs one fetch whatever the radius
+    float sigma = max(0.5 * float(blurRadius), 0.5);
+
+    vec4 sum = vec4(0.0);
+    float weights = 0.0;
+    for (int k = -blurRadius; k <= blurRadius; k++) {
+        ivec2 t = clamp(texel + k * axis, origin, origin + ivec2(region - 1));
+        vec4 m = fromDepth ? warp(texelFetch(depthLayers, ivec3(t, layer), 0).r)
+                           : texelFetch(blurSource, t, 0);
+        float w = exp(-0.5 * float(k * k) / (sigma * sigma));
+        sum += w * m;
+        weights += w;
+    }
+
+    moments = sum / weights;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <glm/glm.hpp>
+#include <limits>
+
+// ---------------------------------------------------------------------------
+// AABB: axis-aligned bounding box. Starts empty (min > max) and grows with
+// extend(); transformed() re-fits the box around its 8 transformed corners.
+// intersects() is a conservative test against a view-projection's clip volume
+// or an exact one against a sphere.
+// ---------------------------------------------------------------------------
+
+struct AABB {
+    glm::vec3 min = glm::vec3( std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+
+    bool empty() const { return min.x > max.x; }
+
+    glm::vec3 center() const { return 0.5f * (min + max); }
+
+    glm::vec3 corner(int i) const {
+        return glm::vec3((i & 1) ? max.x : min.x,
+                         (i & 2) ? max.y : min.y,
+                         (i & 4) ? max.z : min.z);
+    }
+
+    void extend(const glm::vec3 &p) {
+        min = glm::min(min, p);
+        max = glm::max(max, p);
+    }
+
+    void extend(const AABB &box) {
+        if (box.empty()) return;
+        extend(box.min);
+        extend(box.max);
+    }
+
+    AABB transformed(const glm::mat4 &m) const {
+        AABB box;
+        if (empty()) return box;
+        for (int i = 0; i < 8; i++) {
+            box.extend(glm::vec3(m * glm::vec4(corner(i), 1.f)));
+        }
+        return box;
+    }
+
+    // False only when all 8 corners lie outside the same clip plane
+    bool intersects(const glm::mat4 &viewProj) const {
+        if (empty()) return false;
+
+        glm::vec4 clip[8];
+        for (int i = 0; i < 8; i++) clip[i] = viewProj * glm::vec4(corner(i), 1.f);
+
+        for (int axis = 0; axis < 3; axis++) {
+            bool below = true, above = true;
+            for (const glm::vec4 &c : clip) {
+                below = below && c[axis] < -c.w;
+                above = above && c[axis] >  c.w;
+            }
+            if (below || above) return false;
+        }
+        return true;
+    }
+
+    bool intersects(const glm::vec3 &center, float radius) const {
+        if (empty()) return false;
+        glm::vec3 d = center - glm::clamp(center, min, max);
+        return glm::dot(d, d) <= radius * radius;
+    }
+};
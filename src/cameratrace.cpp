@@ -38,43 +38,23 @@ void main() {
 
 // --------------------- Helper: shader build ---------------------
 
-static GLuint compileShader(GLenum type, const char *src) {
-    GLuint s = glCreateShader(type);
-    glShaderSource(s, 1, &src, nullptr);
-    glCompileShader(s);
-    GLint status = GL_FALSE;
-    glGetShaderiv(s, GL_COMPILE_STATUS, &status);
-    if (!status) {
-        GLint len = 0;
-        glGetShaderiv(s, GL_INFO_LOG_LENGTH, &len);
-        std::vector<char> log(len);
-        glGetShaderInfoLog(s, len, nullptr, log.data());
-        std::cerr << "CameraTrace shader compile error:\n" << log.data() << std::endl;
-    }
-    return s;
-}
-
 GLuint CameraTrace::buildShaderProgram() {
-    GLuint vs = compileShader(GL_VERTEX_SHADER, TRACE_VERT);
-    GLuint fs = compileShader(GL_FRAGMENT_SHADER, TRACE_FRAG);
-
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, vs);
-    glAttachShader(prog, fs);
-    glLinkProgram(prog);
-
-    GLint status = GL_FALSE;
-    glGetProgramiv(prog, GL_LINK_STATUS, &status);
-    if (!status) {
-        GLint len = 0;
-        glGetProgramiv(prog, GL_INFO_LOG_LENGTH, &len);
-        std::vector<char> log(len);
-        glGetProgramInfoLog(prog, len, nullptr, log.data());
-        std::cerr << "CameraTrace program link error:\n" << log.data() << std::endl;
+    ShaderReflection reflection;
+    GLuint prog = 0;
+    try {
+        prog = ShaderLoader::createShaderProgramFromSource({
+            { GL_VERTEX_SHADER,   TRACE_VERT },
+            { GL_FRAGMENT_SHADER, TRACE_FRAG },
+        }, &reflection);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "CameraTrace shader error:\n" << e.what() << std::endl;
+        return 0;
     }
 
-    glDeleteShader(vs);
-    glDeleteShader(fs);
+    // Cache uniform locations
+    m_uView = reflection.uniform("view");
+    m_uProj = reflection.uniform("proj");
+
     return prog;
 }
 
@@ -113,6 +93,7 @@ void CameraTrace::destroy() {
     if (m_vao) glDeleteVertexArrays(1, &m_vao);
     if (m_prog) glDeleteProgram(m_prog);
     m_vbo = m_vao = m_prog = 0;
+    m_uView = m_uProj = -1;
     m_nodes.clear();
 }
 
@@ -185,10 +166,8 @@ void CameraTrace::draw(const glm::mat4 &view, const glm::mat4 &proj) {
 
     glUseProgram(m_prog);
 
-    GLint locView = glGetUniformLocation(m_prog, "view");
-    GLint locProj = glGetUniformLocation(m_prog, "proj");
-    glUniformMatrix4fv(locView, 1, GL_FALSE, glm::value_ptr(view));
-    glUniformMatrix4fv(locProj, 1, GL_FALSE, glm::value_ptr(proj));
+    glUniformMatrix4fv(m_uView, 1, GL_FALSE, glm::value_ptr(view));
+    glUniformMatrix4fv(m_uProj, 1, GL_FALSE, glm::value_ptr(proj));
 
     glBindVertexArray(m_vao);
 
@@ -5,6 +5,7 @@
 #endif
 
 #include <GL/glew.h>
+#include "utils/shaderloader.h"
 #include <glm/glm.hpp>
 #include <vector>
 
@@ -33,6 +34,8 @@ private:
     GLuint m_vao = 0;
     GLuint m_vbo = 0;
     GLuint m_prog = 0;
+    GLint  m_uView = -1;
+    GLint  m_uProj = -1;
 
     // trail tuning
     float m_maxAge = 3.0f;        // seconds before a node disappears
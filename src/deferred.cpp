@@ -0,0 +1,116 @@
+#include "realtime.h"
+#include "settings.h"
+
+#include <iostream>
+
+// ================================================================
+// Deferred shading. The geometry pass writes each visible surface
+// once into a compact G-buffer (albedo, octahedral normal +
+// material slot, depth); a single full-screen pass then runs the
+// clustered light loop per pixel instead of per fragment, so
+// overdraw no longer multiplies the PCF and lighting cost.
+// Ambient, specular colour and shininess come from the material
+// table through the stored slot. Selected with
+// settings.deferredShading; the forward path stays the default.
+// ================================================================
+
+void DeferredUniforms::load(const ShaderReflection &r) {
+    lighting.load(r);
+    gAlbedo         = r.uniform("gAlbedo");
+    gNormalMaterial = r.uniform("gNormalMaterial");
+    gDepth          = r.uniform("gDepth");
+    invViewProj     = r.uniform("invViewProj");
+}
+
+void Realtime::makeGBuffer() {
+    auto makeTarget = [&](GLuint &texture, GLenum internalFormat, GLenum format, GLenum type) {
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_fbo_width, m_fbo_height, 0, format, type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    };
+
+    glActiveTexture(GL_TEXTURE0);
+    makeTarget(m_gbuffer_albedo, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    makeTarget(m_gbuffer_normal, GL_RGBA16UI, GL_RGBA_INTEGER, GL_UNSIGNED_SHORT);
+    makeTarget(m_gbuffer_depth, GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_gbuffer_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_gbuffer_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_gbuffer_albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, m_gbuffer_normal, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_gbuffer_depth, 0);
+
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "G-buffer FBO incomplete" << std::endl;
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+}
+
+void Realtime::deleteGBuffer() {
+    if (m_gbuffer_albedo) glDeleteTextures(1, &m_gbuffer_albedo);
+    if (m_gbuffer_normal) glDeleteTextures(1, &m_gbuffer_normal);
+    if (m_gbuffer_depth)  glDeleteTextures(1, &m_gbuffer_depth);
+    if (m_gbuffer_fbo)    glDeleteFramebuffers(1, &m_gbuffer_fbo);
+    m_gbuffer_albedo = m_gbuffer_normal = m_gbuffer_depth = m_gbuffer_fbo = 0;
+}
+
+void Realtime::paintDeferred() {
+    // The lighting pass resolves into the caller's target (HDR or m_fbo)
+    GLint target = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+
+    prepareFrame();
+    const uint32_t features = frameFeatures();
+
+    // ---- geometry pass: surfaces into the G-buffer ----
+    // Colour targets need no clear: pixels left at depth 1 are skipped
+    glBindFramebuffer(GL_FRAMEBUFFER, m_gbuffer_fbo);
+    glViewport(0, 0, m_fbo_width, m_fbo_height);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    drawBatches(true, features);
+
+    // ---- lighting pass: one full-screen quad into the target ----
+    const DeferredProgram &variant = deferredProgram(features);
+    const DeferredUniforms &u = variant.uniforms;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glUseProgram(variant.program);
+    bindLighting(u.lighting, features);
+    bindSurface(u.lighting);
+
+    glm::mat4 invViewProj = glm::inverse(m_proj * m_view);
+    glUniformMatrix4fv(u.invViewProj, 1, GL_FALSE, &invViewProj[0][0]);
+
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_ALBEDO_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_gbuffer_albedo);
+    glUniform1i(u.gAlbedo, GBUFFER_ALBEDO_UNIT);
+
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_NORMAL_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_gbuffer_normal);
+    glUniform1i(u.gNormalMaterial, GBUFFER_NORMAL_UNIT);
+
+    glActiveTexture(GL_TEXTURE0 + GBUFFER_DEPTH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, m_gbuffer_depth);
+    glUniform1i(u.gDepth, GBUFFER_DEPTH_UNIT);
+
+    // The quad copies the G-buffer depth through gl_FragDepth, so later
+    // passes (camera trace) still depth-test against the scene
+    glDepthFunc(GL_ALWAYS);
+    glBindVertexArray(m_fullscreen_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindVertexArray(0);
+    glDepthFunc(GL_LESS);
+
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+}
@@ -1,6 +1,11 @@
 #include "realtime.h"
 #include "iostream"
 
+void TextureUniforms::load(const ShaderReflection &r) {
+    colorTexture = r.uniform("colorTexture");
+    depthTexture = r.uniform("depthTexture");
+}
+
 void Realtime::makeFBO() {
     // color texture
     glGenTextures(1, &m_fbo_texture);
@@ -77,12 +82,12 @@ void Realtime::paintTexture(GLuint colorTexture, GLuint depthTexture) {
     // bind color texture to slot 0
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, colorTexture);
-    glUniform1i(glGetUniformLocation(m_texture_shader, "colorTexture"), 0);
+    glUniform1i(m_texture_uniforms.colorTexture, 0);
 
     // bind depth texture to slot 1
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, depthTexture);
-    glUniform1i(glGetUniformLocation(m_texture_shader, "depthTexture"), 1);
+    glUniform1i(m_texture_uniforms.depthTexture, 1);
 
     // draw fullscreen quad
     glDrawArrays(GL_TRIANGLES, 0, 6);
@@ -0,0 +1,396 @@
+#include "geometryarena.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <numeric>
+
+static constexpr GLsizei MIN_VERTICES = 1 << 16;
+static constexpr GLsizei MIN_INDICES  = 1 << 17;
+static constexpr GLsizei VERTEX_BYTES = GeometryArena::FLOATS_PER_VERTEX * sizeof(float);
+static constexpr GLsizei POSITION_BYTES = 3 * sizeof(float);
+
+static bool hasMultiDrawIndirect() { return GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect; }
+static bool hasBaseInstance()      { return GLEW_VERSION_4_2 || GLEW_ARB_base_instance; }
+
+// ====================== ArenaBuffer ======================
+
+void ArenaBuffer::init(GLsizei elementBytes, GLsizei capacity) {
+    destroy();
+
+    m_elementBytes = elementBytes;
+    m_capacity     = capacity;
+
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(capacity) * elementBytes, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void ArenaBuffer::destroy() {
+    if (m_buffer) glDeleteBuffers(1, &m_buffer);
+    m_buffer   = 0;
+    m_capacity = m_top = 0;
+    m_free.clear();
+}
+
+ArenaRange ArenaBuffer::allocate(const void *data, GLsizei count) {
+    if (count == 0) return {};
+
+    // First fit from the free list, else bump the high-water mark
+    ArenaRange range{ -1, count };
+    for (auto it = m_free.begin(); it != m_free.end(); ++it) {
+        if (it->count < count) continue;
+        range.first = it->first;
+        it->first += count;
+        it->count -= count;
+        if (it->count == 0) m_free.erase(it);
+        break;
+    }
+    if (range.first < 0) {
+        if (m_top + count > m_capacity) grow(m_top + count);
+        range.first = m_top;
+        m_top += count;
+    }
+
+    // Uploads go through a copy target so no VAO state is touched
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER,
+                    GLintptr(range.first) * m_elementBytes,
+                    GLsizeiptr(count) * m_elementBytes,
+                    data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    return range;
+}
+
+void ArenaBuffer::release(ArenaRange range) {
+    if (range.count == 0) return;
+
+    auto it = std::lower_bound(m_free.begin(), m_free.end(), range,
+                               [](const ArenaRange &a, const ArenaRange &b) { return a.first < b.first; });
+    it = m_free.insert(it, range);
+
+    // Coalesce with the following and preceding blocks
+    if (it + 1 != m_free.end() && it->first + it->count == (it + 1)->first) {
+        it->count += (it + 1)->count;
+        m_free.erase(it + 1);
+    }
+    if (it != m_free.begin() && (it - 1)->first + (it - 1)->count == it->first) {
+        (it - 1)->count += it->count;
+        it = m_free.erase(it) - 1;
+    }
+
+    // Give the tail back to the bump allocator
+    if (it->first + it->count == m_top) {
+        m_top = it->first;
+        m_free.erase(it);
+    }
+}
+
+void ArenaBuffer::grow(GLsizei minCapacity) {
+    GLsizei capacity = std::max(minCapacity, m_capacity * 2);
+
+    GLuint buffer = 0;
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, GLsizeiptr(capacity) * m_elementBytes, nullptr, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, m_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                        GLsizeiptr(m_top) * m_elementBytes);
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &m_buffer);
+
+    m_buffer   = buffer;
+    m_capacity = capacity;
+}
+
+// ====================== Setup ======================
+
+void GeometryArena::init() {
+    destroy();
+
+    glGenVertexArrays(1, &m_vao);
+    glGenBuffers(1, &m_instanceVbo);
+    glGenBuffers(1, &m_indirect);
+    glGenVertexArrays(1, &m_depthVao);
+    glGenBuffers(1, &m_depthInstanceVbo);
+    glGenBuffers(1, &m_depthIndirect);
+
+    m_vertices.init(VERTEX_BYTES, MIN_VERTICES);
+    m_positions.init(POSITION_BYTES, MIN_VERTICES);
+    m_indices.init(sizeof(GLuint), MIN_INDICES);
+
+    setupVertexAttribs();
+
+    // Per-instance attributes: model (3..6), normalModel (7..9), material (10), instance (11)
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+    for (int c = 0; c < 4; c++) {
+        glEnableVertexAttribArray(3 + c);
+        glVertexAttribDivisor(3 + c, 1);
+    }
+    for (int c = 0; c < 3; c++) {
+        glEnableVertexAttribArray(7 + c);
+        glVertexAttribDivisor(7 + c, 1);
+    }
+    glEnableVertexAttribArray(10);
+    glVertexAttribDivisor(10, 1);
+    glEnableVertexAttribArray(11);
+    glVertexAttribDivisor(11, 1);
+    setInstanceOffset(0);
+
+    // Depth stream instances: model (3..6), shadow layer mask (7)
+    glBindVertexArray(m_depthVao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_depthInstanceVbo);
+    for (int c = 0; c < 5; c++) {
+        glEnableVertexAttribArray(3 + c);
+        glVertexAttribDivisor(3 + c, 1);
+    }
+    setDepthInstanceOffset(0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::destroy() {
+    m_vertices.destroy();
+    m_positions.destroy();
+    m_indices.destroy();
+
+    if (m_instanceVbo) glDeleteBuffers(1, &m_instanceVbo);
+    if (m_indirect)    glDeleteBuffers(1, &m_indirect);
+    if (m_vao)         glDeleteVertexArrays(1, &m_vao);
+    m_vao = m_instanceVbo = m_indirect = 0;
+
+    if (m_depthInstanceVbo) glDeleteBuffers(1, &m_depthInstanceVbo);
+    if (m_depthIndirect)    glDeleteBuffers(1, &m_depthIndirect);
+    if (m_depthVao)         glDeleteVertexArrays(1, &m_depthVao);
+    m_depthVao = m_depthInstanceVbo = m_depthIndirect = 0;
+
+    m_commands.clear();
+    m_depthCommands.clear();
+}
+
+// Points both VAOs at the current vertex and index buffers
+void GeometryArena::setupVertexAttribs() const {
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_vertices.buffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices.buffer());
+
+    glEnableVertexAttribArray(0); // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)0);
+    glEnableVertexAttribArray(1); // normal
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(2); // uv
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, VERTEX_BYTES, (void*)(6 * sizeof(float)));
+
+    glBindVertexArray(m_depthVao);
+    glBindBuffer(GL_ARRAY_BUFFER, m_positions.buffer());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indices.buffer());
+
+    glEnableVertexAttribArray(0); // position
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, POSITION_BYTES, (void*)0);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+// Expects the VAO bound and m_instanceVbo bound to GL_ARRAY_BUFFER
+void GeometryArena::setInstanceOffset(GLuint baseInstance) const {
+    const GLsizei stride = sizeof(InstanceData);
+    const size_t base = size_t(baseInstance) * stride;
+
+    for (int c = 0; c < 4; c++) {
+        glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, model) + c * sizeof(glm::vec4)));
+    }
+    for (int c = 0; c < 3; c++) {
+        glVertexAttribPointer(7 + c, 3, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(InstanceData, normalModel) + c * sizeof(glm::vec3)));
+    }
+    glVertexAttribIPointer(10, 1, GL_INT, stride,
+                           (void*)(base + offsetof(InstanceData, material)));
+    glVertexAttribIPointer(11, 1, GL_INT, stride,
+                           (void*)(base + offsetof(InstanceData, instance)));
+}
+
+// Expects m_depthVao bound and m_depthInstanceVbo bound to GL_ARRAY_BUFFER
+void GeometryArena::setDepthInstanceOffset(GLuint baseInstance) const {
+    const GLsizei stride = sizeof(DepthInstance);
+    const size_t base = size_t(baseInstance) * stride;
+
+    for (int c = 0; c < 4; c++) {
+        glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, stride,
+                              (void*)(base + offsetof(DepthInstance, model) + c * sizeof(glm::vec4)));
+    }
+    glVertexAttribIPointer(7, 1, GL_UNSIGNED_INT, stride,
+                           (void*)(base + offsetof(DepthInstance, layers)));
+}
+
+// ====================== Sub-allocation ======================
+
+MeshRange GeometryArena::allocate(std::span<const float> vertices, int floatsPerVertex,
+                                  std::span<const GLuint> indices) {
+    GLsizei count = static_cast<GLsizei>(vertices.size() / floatsPerVertex);
+    if (count == 0) return {};
+
+    // Widen to the arena's pos/nor/uv layout
+    std::vector<float> widened;
+    const float *src = vertices.data();
+    if (floatsPerVertex != FLOATS_PER_VERTEX) {
+        widened.assign(size_t(count) * FLOATS_PER_VERTEX, 0.f);
+        for (GLsizei v = 0; v < count; v++) {
+            std::copy_n(&vertices[size_t(v) * floatsPerVertex], floatsPerVertex,
+                        &widened[size_t(v) * FLOATS_PER_VERTEX]);
+        }
+        src = widened.data();
+    }
+
+    // Triangle soup: index every vertex in order
+    std::vector<GLuint> sequential;
+    std::span<const GLuint> elements = indices;
+    if (indices.empty()) {
+        sequential.resize(count);
+        std::iota(sequential.begin(), sequential.end(), 0u);
+        elements = sequential;
+    }
+
+    // Packed positions for the depth stream
+    std::vector<float> positions(size_t(count) * 3);
+    for (GLsizei v = 0; v < count; v++) {
+        std::copy_n(&src[size_t(v) * FLOATS_PER_VERTEX], 3, &positions[size_t(v) * 3]);
+    }
+
+    GLuint vbo = m_vertices.buffer();
+    GLuint pbo = m_positions.buffer();
+    GLuint ebo = m_indices.buffer();
+
+    MeshRange range;
+    range.vertices = m_vertices.allocate(src, count);
+    range.indices  = m_indices.allocate(elements.data(), static_cast<GLsizei>(elements.size()));
+
+    // Same allocation sequence on both pools, so the same offset
+    [[maybe_unused]] ArenaRange mirrored = m_positions.allocate(positions.data(), count);
+    assert(mirrored.first == range.vertices.first);
+
+    // The VAOs captured the old buffers if any pool grew
+    if (vbo != m_vertices.buffer() || pbo != m_positions.buffer() || ebo != m_indices.buffer()) {
+        setupVertexAttribs();
+    }
+
+    return range;
+}
+
+void GeometryArena::release(const MeshRange &range) {
+    m_vertices.release(range.vertices);
+    m_positions.release(range.vertices);
+    m_indices.release(range.indices);
+}
+
+// ====================== Per-frame data ======================
+
+void GeometryArena::setInstances(const std::vector<InstanceData> &instances) {
+    glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 instances.size() * sizeof(InstanceData),
+                 instances.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::setCommands(const std::vector<DrawElementsIndirectCommand> &commands) {
+    m_commands = commands;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 commands.size() * sizeof(DrawElementsIndirectCommand),
+                 commands.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void GeometryArena::setDepthInstances(const std::vector<DepthInstance> &instances) {
+    glBindBuffer(GL_ARRAY_BUFFER, m_depthInstanceVbo);
+    glBufferData(GL_ARRAY_BUFFER,
+                 instances.size() * sizeof(DepthInstance),
+                 instances.data(),
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GeometryArena::setDepthCommands(const std::vector<DrawElementsIndirectCommand> &commands) {
+    m_depthCommands = commands;
+
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_depthIndirect);
+    glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                 commands.size() * sizeof(DrawElementsIndirectCommand),
+                 commands.data(),
+                 GL_STREAM_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+// ====================== Submission ======================
+
+void GeometryArena::bind() const {
+    glBindVertexArray(m_vao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_indirect);
+}
+
+void GeometryArena::bindDepth() const {
+    glBindVertexArray(m_depthVao);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, m_depthIndirect);
+}
+
+void GeometryArena::draw(GLenum mode, int firstCommand, int commandCount) const {
+    submit(m_commands, false, mode, firstCommand, commandCount);
+}
+
+void GeometryArena::drawDepth(GLenum mode, int firstCommand, int commandCount) const {
+    submit(m_depthCommands, true, mode, firstCommand, commandCount);
+}
+
+// Expects the matching bind() / bindDepth()
+void GeometryArena::submit(const std::vector<DrawElementsIndirectCommand> &commands, bool depth,
+                           GLenum mode, int firstCommand, int commandCount) const {
+    if (commandCount <= 0) return;
+
+    if (hasMultiDrawIndirect()) {
+        glMultiDrawElementsIndirect(mode, GL_UNSIGNED_INT,
+                                    (void*)(firstCommand * sizeof(DrawElementsIndirectCommand)),
+                                    commandCount, 0);
+        return;
+    }
+
+    // GL 4.1 (macOS): one instanced draw per command
+    if (!hasBaseInstance()) glBindBuffer(GL_ARRAY_BUFFER, depth ? m_depthInstanceVbo : m_instanceVbo);
+
+    for (int i = firstCommand; i < firstCommand + commandCount; i++) {
+        const DrawElementsIndirectCommand &cmd = commands[i];
+        const void *offset = (void*)(size_t(cmd.firstIndex) * sizeof(GLuint));
+        if (hasBaseInstance()) {
+            glDrawElementsInstancedBaseVertexBaseInstance(mode, cmd.count, GL_UNSIGNED_INT, offset,
+                                                          cmd.instanceCount, cmd.baseVertex,
+                                                          cmd.baseInstance);
+        } else {
+            if (depth) setDepthInstanceOffset(cmd.baseInstance);
+            else       setInstanceOffset(cmd.baseInstance);
+            glDrawElementsInstancedBaseVertex(mode, cmd.count, GL_UNSIGNED_INT, offset,
+                                              cmd.instanceCount, cmd.baseVertex);
+        }
+    }
+
+    if (!hasBaseInstance()) {
+        if (depth) setDepthInstanceOffset(0);
+        else       setInstanceOffset(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+}
+
+void GeometryArena::unbind() const {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+// Per-instance vertex attributes (locations 3..11 in default.vert)
+struct InstanceData {
+    glm::mat4 model;
+    glm::mat3 normalModel;
+    GLint     material;    // index into the material buffer texture
+    GLint     instance;    // own index in the instance buffer (per-object light list)
+};
+
+// Per-instance attributes of the depth stream (locations 3..7 in shadowmap.vert)
+struct DepthInstance {
+    glm::mat4 model;
+    GLuint    layers;      // bit per shadow array layer the instance may cover
+};
+
+// Layout of GL_DRAW_INDIRECT_BUFFER entries for glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// A block of elements (vertices or indices) inside one arena buffer
+struct ArenaRange {
+    GLint   first = 0;
+    GLsizei count = 0;
+};
+
+// One mesh in the arena; its indices are relative to vertices.first
+struct MeshRange {
+    ArenaRange vertices;
+    ArenaRange indices;
+};
+
+// ---------------------------------------------------------------------------
+// ArenaBuffer: a GL buffer with a first-fit sub-allocator over fixed-size
+// elements. Growing reallocates and copies on the GPU, so the buffer name
+// changes and anything that captured it (a VAO) must be re-pointed.
+// ---------------------------------------------------------------------------
+
+class ArenaBuffer {
+public:
+    void init(GLsizei elementBytes, GLsizei capacity);
+    void destroy();
+
+    ArenaRange allocate(const void *data, GLsizei count);
+    void release(ArenaRange range);
+
+    GLuint buffer() const { return m_buffer; }
+
+private:
+    GLuint  m_buffer       = 0;
+    GLsizei m_elementBytes = 0;
+    GLsizei m_capacity     = 0;   // elements allocated on the GPU
+    GLsizei m_top          = 0;   // high-water mark
+    std::vector<ArenaRange> m_free;   // sorted by first, coalesced
+
+    void grow(GLsizei minCapacity);
+};
+
+// ---------------------------------------------------------------------------
+// GeometryArena: all static geometry in one interleaved VBO
+// (pos(3) + nor(3) + uv(2)) and one GL_UNSIGNED_INT index buffer behind a
+// single VAO, with one shared instance buffer and an indirect command buffer.
+// Per-draw data reaches the shader through baseInstance on the instance
+// attributes, so a whole batch of draws is one glMultiDrawElementsIndirect.
+//
+// A second, depth-only stream shares the index buffer but reads a packed
+// copy of the positions (12 of the 32 bytes per vertex) and its own
+// instance and command buffers, so shadow passes can submit a culled
+// subset of the draws. The position pool mirrors every vertex allocation,
+// so both streams use the same baseVertex.
+// ---------------------------------------------------------------------------
+
+class GeometryArena {
+public:
+    static constexpr int FLOATS_PER_VERTEX = 8;
+
+    GeometryArena() = default;
+
+    void init();
+    void destroy();
+
+    // Copies vertices (3, 6 or 8 floats each) into the arena as 8-float
+    // vertices. An empty index list means the vertices are a triangle soup.
+    MeshRange allocate(std::span<const float> vertices, int floatsPerVertex,
+                       std::span<const GLuint> indices);
+    void release(const MeshRange &range);
+
+    void setInstances(const std::vector<InstanceData> &instances);
+    void setCommands(const std::vector<DrawElementsIndirectCommand> &commands);
+
+    // Depth-only stream (positions + DepthInstance)
+    void setDepthInstances(const std::vector<DepthInstance> &instances);
+    void setDepthCommands(const std::vector<DrawElementsIndirectCommand> &commands);
+
+    // Bind once per pass, then submit any contiguous run of commands
+    void bind() const;
+    void draw(GLenum mode, int firstCommand, int commandCount) const;
+    void bindDepth() const;
+    void drawDepth(GLenum mode, int firstCommand, int commandCount) const;
+    void unbind() const;
+
+private:
+    GLuint m_vao         = 0;
+    GLuint m_instanceVbo = 0;
+    GLuint m_indirect    = 0;
+
+    GLuint m_depthVao         = 0;
+    GLuint m_depthInstanceVbo = 0;
+    GLuint m_depthIndirect    = 0;
+
+    ArenaBuffer m_vertices;
+    ArenaBuffer m_positions;   // mirrors m_vertices, 3 floats per vertex
+    ArenaBuffer m_indices;
+
+    std::vector<DrawElementsIndirectCommand> m_commands;      // CPU copies for fallback
+    std::vector<DrawElementsIndirectCommand> m_depthCommands;
+
+    void setupVertexAttribs() const;
+    void setInstanceOffset(GLuint baseInstance) const;
+    void setDepthInstanceOffset(GLuint baseInstance) const;
+    void submit(const std::vector<DrawElementsIndirectCommand> &commands, bool depth,
+                GLenum mode, int firstCommand, int commandCount) const;
+};
@@ -50,44 +50,22 @@ void main() {
 // ====================== Helpers ======================
 
 GLuint HDR::buildShader() {
-    auto make = [&](GLenum type, const char* src) {
-        GLuint s = glCreateShader(type);
-        glShaderSource(s, 1, &src, nullptr);
-        glCompileShader(s);
-        GLint ok = GL_FALSE;
-        glGetShaderiv(s, GL_COMPILE_STATUS, &ok);
-        if (!ok) {
-            char log[1024];
-            glGetShaderInfoLog(s, 1024, nullptr, log);
-            std::cerr << "Shader compile error:\n" << log << "\n";
-        }
-        return s;
-    };
-
-    GLuint v = make(GL_VERTEX_SHADER, TM_VERT);
-    GLuint f = make(GL_FRAGMENT_SHADER, TM_FRAG);
-
-    GLuint prog = glCreateProgram();
-    glAttachShader(prog, v);
-    glAttachShader(prog, f);
-    glLinkProgram(prog);
-
-    GLint ok = GL_FALSE;
-    glGetProgramiv(prog, GL_LINK_STATUS, &ok);
-    if (!ok) {
-        char log[1024];
-        glGetProgramInfoLog(prog, 1024, nullptr, log);
-        std::cerr << "Program link error:\n" << log << "\n";
+    // Compiled (or restored from the program binary cache) like the file shaders
+    ShaderReflection reflection;
+    GLuint prog = 0;
+    try {
+        prog = ShaderLoader::createShaderProgramFromSource({
+            { GL_VERTEX_SHADER,   TM_VERT },
+            { GL_FRAGMENT_SHADER, TM_FRAG },
+        }, &reflection);
+    } catch (const std::runtime_error &e) {
+        std::cerr << "Tonemap shader error:\n" << e.what() << "\n";
+        return 0;
     }
 
-    glDeleteShader(v);
-    glDeleteShader(f);
-
     // Cache uniform locations
-    glUseProgram(prog);
-    m_uHdrBuffer = glGetUniformLocation(prog, "hdrBuffer");
-    m_uExposure  = glGetUniformLocation(prog, "exposure");
-    glUseProgram(0);
+    m_uHdrBuffer = reflection.uniform("hdrBuffer");
+    m_uExposure  = reflection.uniform("exposure");
 
     return prog;
 }
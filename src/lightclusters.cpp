@@ -0,0 +1,243 @@
+#include "realtime.h"
+#include "settings.h"
+#include "glm/gtc/constants.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// ================================================================
+// Clustered forward lighting. The view frustum is cut into
+// CLUSTER_X x CLUSTER_Y screen tiles and CLUSTER_Z depth slices,
+// spaced exponentially between the near and far planes. Every
+// bounded light is tested against the clusters its bounding sphere
+// can reach; unbounded lights (directional, no falloff) go into all
+// of them. default.frag walks only its own cluster's list, or its
+// object's list (lights whose sphere or cone reaches the instance's
+// world bounds) when that one is shorter.
+// ================================================================
+
+void Realtime::initializeClusters() {
+    glGenBuffers(1, &m_light_buffer);
+    glGenTextures(1, &m_light_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_light_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_light_buffer);
+
+    glGenBuffers(1, &m_cluster_buffer);
+    glGenTextures(1, &m_cluster_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_cluster_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_cluster_buffer);
+
+    glGenBuffers(1, &m_cluster_index_buffer);
+    glGenTextures(1, &m_cluster_index_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_cluster_index_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_cluster_index_buffer);
+
+    glGenBuffers(1, &m_object_range_buffer);
+    glGenTextures(1, &m_object_range_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_object_range_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, m_object_range_buffer);
+
+    glGenBuffers(1, &m_object_light_buffer);
+    glGenTextures(1, &m_object_light_texture);
+    glBindTexture(GL_TEXTURE_BUFFER, m_object_light_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, m_object_light_buffer);
+
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+    m_clusters_dirty = true;
+    m_object_lights_dirty = true;
+}
+
+// World-space sphere around everything a light can reach; false for
+// unbounded lights. Spot lights use the smallest sphere around their cone.
+static bool lightBounds(const SceneLightData &light, float range, glm::vec3 &center, float &radius) {
+    if (range <= 0.0f) return false;
+
+    center = glm::vec3(light.pos);
+    radius = range;
+    if (light.type != LightType::LIGHT_SPOT || light.angle >= glm::half_pi<float>()) return true;
+
+    glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+    if (light.angle > glm::quarter_pi<float>()) {
+        center += std::cos(light.angle) * range * dir;
+        radius  = std::sin(light.angle) * range;
+    } else {
+        radius  = range / (2.0f * std::cos(light.angle));
+        center += radius * dir;
+    }
+    return true;
+}
+
+void Realtime::assignLightClusters(const glm::mat4 &view, const glm::mat4 &proj) {
+    // Lists only change with the camera or the lights
+    if (!m_clusters_dirty && view == m_cluster_view && proj == m_cluster_proj) return;
+
+    const float zNear = std::max(settings.nearPlane, 0.01f);
+    const float zFar  = std::max(settings.farPlane, zNear + 0.01f);
+    const float logRatio = std::log(zFar / zNear);
+    auto sliceDepth = [&](int z) { return zNear * std::pow(zFar / zNear, float(z) / CLUSTER_Z); };
+    auto sliceOf = [&](float depth) {
+        return std::clamp(int(std::floor(std::log(depth / zNear) / logRatio * CLUSTER_Z)), 0, CLUSTER_Z - 1);
+    };
+    auto tileOf = [](float ndc, int tiles) {
+        return std::clamp(int(std::floor((ndc * 0.5f + 0.5f) * tiles)), 0, tiles - 1);
+    };
+    auto clusterIndex = [](int x, int y, int z) { return (z * CLUSTER_Y + y) * CLUSTER_X + x; };
+
+    // ---- view-space cluster boxes, rebuilt when the projection changes ----
+    if (proj != m_cluster_proj || m_cluster_bounds.empty()) {
+        m_cluster_bounds.assign(CLUSTER_X * CLUSTER_Y * CLUSTER_Z, AABB{});
+        for (int z = 0; z < CLUSTER_Z; z++) {
+            const float depths[2] = { sliceDepth(z), sliceDepth(z + 1) };
+            for (int y = 0; y < CLUSTER_Y; y++) {
+                for (int x = 0; x < CLUSTER_X; x++) {
+                    AABB &box = m_cluster_bounds[clusterIndex(x, y, z)];
+                    for (int k = 0; k < 8; k++) {
+                        float ndcX = -1.0f + 2.0f * float(x + (k & 1)) / CLUSTER_X;
+                        float ndcY = -1.0f + 2.0f * float(y + ((k >> 1) & 1)) / CLUSTER_Y;
+                        float d = depths[k >> 2];
+                        box.extend(glm::vec3(ndcX * d / proj[0][0], ndcY * d / proj[1][1], -d));
+                    }
+                }
+            }
+        }
+    }
+
+    m_cluster_view   = view;
+    m_cluster_proj   = proj;
+    m_clusters_dirty = false;
+
+    // ---- (cluster, light) references ----
+    std::vector<GLuint> counts(CLUSTER_X * CLUSTER_Y * CLUSTER_Z, 0);
+    std::vector<std::pair<int, GLuint>> refs;
+    std::vector<GLuint> unbounded;
+
+    for (size_t i = 0; i < m_renderData.lights.size(); i++) {
+        const SceneLightData &light = m_renderData.lights[i];
+        float range = i < m_light_ranges.size() ? m_light_ranges[i] : 0.0f;
+
+        glm::vec3 centerWorld;
+        float radius;
+        if (!lightBounds(light, range, centerWorld, radius)) {
+            unbounded.push_back(static_cast<GLuint>(i));
+            continue;
+        }
+
+        glm::vec3 center = glm::vec3(view * glm::vec4(centerWorld, 1.0f));
+        float depthMin = -center.z - radius;
+        float depthMax = -center.z + radius;
+        if (depthMax < zNear || depthMin > zFar) continue;
+        depthMin = std::max(depthMin, zNear);
+        depthMax = std::min(depthMax, zFar);
+
+        // Screen rectangle of the sphere's box, clipped to the near plane
+        float ndcMin[2] = {  1.0f,  1.0f };
+        float ndcMax[2] = { -1.0f, -1.0f };
+        for (int axis = 0; axis < 2; axis++) {
+            for (float side : { -radius, radius }) {
+                for (float depth : { depthMin, depthMax }) {
+                    float ndc = (center[axis] + side) * proj[axis][axis] / depth;
+                    ndcMin[axis] = std::min(ndcMin[axis], ndc);
+                    ndcMax[axis] = std::max(ndcMax[axis], ndc);
+                }
+            }
+        }
+        if (ndcMax[0] < -1.0f || ndcMin[0] > 1.0f || ndcMax[1] < -1.0f || ndcMin[1] > 1.0f) continue;
+
+        const int x0 = tileOf(ndcMin[0], CLUSTER_X), x1 = tileOf(ndcMax[0], CLUSTER_X);
+        const int y0 = tileOf(ndcMin[1], CLUSTER_Y), y1 = tileOf(ndcMax[1], CLUSTER_Y);
+        const int z0 = sliceOf(depthMin),            z1 = sliceOf(depthMax);
+
+        for (int z = z0; z <= z1; z++) {
+            for (int y = y0; y <= y1; y++) {
+                for (int x = x0; x <= x1; x++) {
+                    int cluster = clusterIndex(x, y, z);
+                    if (!m_cluster_bounds[cluster].intersects(center, radius)) continue;
+                    refs.emplace_back(cluster, static_cast<GLuint>(i));
+                    counts[cluster]++;
+                }
+            }
+        }
+    }
+
+    // ---- flatten: per-cluster ranges into one index list ----
+    const size_t clusterCount = counts.size();
+    const GLuint globalCount  = static_cast<GLuint>(unbounded.size());
+
+    std::vector<glm::uvec2> ranges(clusterCount);
+    GLuint offset = 0;
+    for (size_t c = 0; c < clusterCount; c++) {
+        ranges[c] = glm::uvec2(offset, counts[c] + globalCount);
+        offset += counts[c] + globalCount;
+    }
+
+    std::vector<GLuint> indices(offset);
+    std::vector<GLuint> cursor(clusterCount);
+    for (size_t c = 0; c < clusterCount; c++) {
+        std::copy(unbounded.begin(), unbounded.end(), indices.begin() + ranges[c].x);
+        cursor[c] = ranges[c].x + globalCount;
+    }
+    for (const auto &[cluster, light] : refs) {
+        indices[cursor[cluster]++] = light;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_cluster_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, ranges.size() * sizeof(glm::uvec2), ranges.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_cluster_index_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(GLuint),
+                 indices.empty() ? nullptr : indices.data(), GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// Conservative sphere vs. spot cone (apex, unit axis, half-angle, length)
+static bool sphereTouchesCone(const glm::vec3 &center, float radius,
+                              const glm::vec3 &apex, const glm::vec3 &axis, float angle, float range) {
+    glm::vec3 v = center - apex;
+    float along = glm::dot(v, axis);
+    if (along > range + radius || along < -radius) return false;
+
+    float across = std::sqrt(std::max(glm::dot(v, v) - along * along, 0.0f));
+    return std::cos(angle) * across - std::sin(angle) * along <= radius;
+}
+
+void Realtime::assignObjectLights() {
+    // Lights and instances are static between edits
+    if (!m_object_lights_dirty) return;
+    m_object_lights_dirty = false;
+
+    std::vector<glm::uvec2> ranges(m_instance_bounds.size());
+    std::vector<GLuint> indices;
+
+    for (size_t k = 0; k < m_instance_bounds.size(); k++) {
+        const AABB &box = m_instance_bounds[k];
+        const glm::vec3 boxCenter = box.center();
+        const float boxRadius = 0.5f * glm::length(box.max - box.min);
+
+        ranges[k].x = static_cast<GLuint>(indices.size());
+        for (size_t i = 0; i < m_renderData.lights.size(); i++) {
+            const SceneLightData &light = m_renderData.lights[i];
+            float range = i < m_light_ranges.size() ? m_light_ranges[i] : 0.0f;
+
+            glm::vec3 center;
+            float radius;
+            if (lightBounds(light, range, center, radius)) {
+                if (!box.intersects(center, radius)) continue;
+                if (light.type == LightType::LIGHT_SPOT && light.angle < glm::half_pi<float>()
+                    && !sphereTouchesCone(boxCenter, boxRadius, glm::vec3(light.pos),
+                                          glm::normalize(glm::vec3(light.dir)), light.angle, range)) {
+                    continue;
+                }
+            }
+            indices.push_back(static_cast<GLuint>(i));
+        }
+        ranges[k].y = static_cast<GLuint>(indices.size()) - ranges[k].x;
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_object_range_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(ranges.size(), 1) * sizeof(glm::uvec2),
+                 ranges.empty() ? nullptr : ranges.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, m_object_light_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(indices.size(), 1) * sizeof(GLuint),
+                 indices.empty() ? nullptr : indices.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
@@ -39,6 +39,16 @@ void MainWindow::initialize() {
     QLabel *ec_label = new QLabel(); // Extra Credit label
     ec_label->setText("Extra Credit");
     ec_label->setFont(font);
+    QLabel *shadows_label = new QLabel(); // Shadows label
+    shadows_label->setText("Shadows");
+    shadows_label->setFont(font);
+    QLabel *shadow_filter_label = new QLabel(); // Shadow filter label
+    shadow_filter_label->setText("Filter:");
+    QLabel *shadow_budget_label = new QLabel(); // Shadow budget label
+    shadow_budget_label->setText("Layers refreshed per frame (0 = all):");
+    QLabel *renderer_label = new QLabel(); // Renderer label
+    renderer_label->setText("Renderer");
+    renderer_label->setFont(font);
     QLabel *param1_label = new QLabel(); // Parameter 1 label
     param1_label->setText("Parameter 1:");
     QLabel *param2_label = new QLabel(); // Parameter 2 label
@@ -163,6 +173,29 @@ void MainWindow::initialize() {
     ec4->setText(QStringLiteral("Extra Credit 4"));
     ec4->setChecked(false);
 
+    // Shadows: taps per shadow lookup, stored as item data
+    shadowFilter = new QComboBox();
+    shadowFilter->addItem(QStringLiteral("1 tap (bilinear compare)"), 1);
+    shadowFilter->addItem(QStringLiteral("4-tap Poisson"), 4);
+    shadowFilter->addItem(QStringLiteral("8-tap Poisson"), 8);
+    shadowFilter->addItem(QStringLiteral("16-tap Poisson"), 16);
+    shadowFilter->addItem(QStringLiteral("EVSM (prefiltered)"), 0);
+    shadowFilter->setCurrentIndex(shadowFilter->findData(settings.varianceShadows ? 0 : settings.shadowTaps));
+
+    shadowBudgetBox = new QSpinBox();
+    shadowBudgetBox->setMinimum(0);
+    shadowBudgetBox->setMaximum(32);
+    shadowBudgetBox->setValue(settings.shadowBudget);
+
+    // Renderer: forward (default) or G-buffer + full-screen lighting
+    deferredShading = new QCheckBox();
+    deferredShading->setText(QStringLiteral("Deferred shading"));
+    deferredShading->setChecked(settings.deferredShading);
+
+    bumpMapping = new QCheckBox();
+    bumpMapping->setText(QStringLiteral("Bump mapping"));
+    bumpMapping->setChecked(settings.bumpMapping);
+
     vLayout->addWidget(uploadFile);
     vLayout->addWidget(saveImage);
     vLayout->addWidget(tesselation_label);
@@ -188,6 +221,18 @@ void MainWindow::initialize() {
     vLayout->addWidget(ec3);
     vLayout->addWidget(ec4);
 
+    // Shadows:
+    vLayout->addWidget(shadows_label);
+    vLayout->addWidget(shadow_filter_label);
+    vLayout->addWidget(shadowFilter);
+    vLayout->addWidget(shadow_budget_label);
+    vLayout->addWidget(shadowBudgetBox);
+
+    // Renderer:
+    vLayout->addWidget(renderer_label);
+    vLayout->addWidget(deferredShading);
+    vLayout->addWidget(bumpMapping);
+
     connectUIElements();
 
     // Set default values of 5 for tesselation parameters
@@ -215,6 +260,8 @@ void MainWindow::connectUIElements() {
     connectNear();
     connectFar();
     connectExtraCredit();
+    connectShadowFilter();
+    connectRenderer();
 }
 
 
@@ -265,6 +312,18 @@ void MainWindow::connectExtraCredit() {
     connect(ec4, &QCheckBox::clicked, this, &MainWindow::onExtraCredit4);
 }
 
+void MainWindow::connectShadowFilter() {
+    connect(shadowFilter, static_cast<void(QComboBox::*)(int)>(&QComboBox::currentIndexChanged),
+            this, &MainWindow::onShadowFilter);
+    connect(shadowBudgetBox, static_cast<void(QSpinBox::*)(int)>(&QSpinBox::valueChanged),
+            this, &MainWindow::onShadowBudget);
+}
+
+void MainWindow::connectRenderer() {
+    connect(deferredShading, &QCheckBox::clicked, this, &MainWindow::onDeferredShading);
+    connect(bumpMapping, &QCheckBox::clicked, this, &MainWindow::onBumpMapping);
+}
+
 // From old Project 6
 // void MainWindow::onPerPixelFilter() {
 //     settings.perPixelFilter = !settings.perPixelFilter;
@@ -381,3 +440,30 @@ void MainWindow::onExtraCredit4() {
     settings.extraCredit4 = !settings.extraCredit4;
     realtime->settingsChanged();
 }
+
+// Shadows:
+
+void MainWindow::onShadowFilter(int index) {
+    // 0 selects the prefiltered EVSM lookup, anything else a PCF kernel
+    int taps = shadowFilter->itemData(index).toInt();
+    settings.varianceShadows = (taps == 0);
+    if (taps > 0) settings.shadowTaps = taps;
+    realtime->update();
+}
+
+void MainWindow::onShadowBudget(int value) {
+    settings.shadowBudget = value;
+    realtime->update();
+}
+
+// Renderer:
+
+void MainWindow::onDeferredShading() {
+    settings.deferredShading = !settings.deferredShading;
+    realtime->update();
+}
+
+void MainWindow::onBumpMapping() {
+    settings.bumpMapping = !settings.bumpMapping;
+    realtime->update();
+}
@@ -2,6 +2,7 @@
 
 #include <QMainWindow>
 #include <QCheckBox>
+#include <QComboBox>
 #include <QSlider>
 #include <QSpinBox>
 #include <QDoubleSpinBox>
@@ -31,6 +32,8 @@ private:
     void connectUploadFile();
     void connectSaveImage();
     void connectExtraCredit();
+    void connectShadowFilter();
+    void connectRenderer();
 
     Realtime *realtime;
     AspectRatioWidget *aspectRatioWidget;
@@ -56,6 +59,14 @@ private:
     QCheckBox *ec3;
     QCheckBox *ec4;
 
+    // Shadows:
+    QComboBox *shadowFilter;
+    QSpinBox *shadowBudgetBox;
+
+    // Renderer:
+    QCheckBox *deferredShading;
+    QCheckBox *bumpMapping;
+
 private slots:
     // From old Project 6
     // void onPerPixelFilter();
@@ -75,4 +86,12 @@ private slots:
     void onExtraCredit2();
     void onExtraCredit3();
     void onExtraCredit4();
+
+    // Shadows:
+    void onShadowFilter(int index);
+    void onShadowBudget(int value);
+
+    // Renderer:
+    void onDeferredShading();
+    void onBumpMapping();
 };
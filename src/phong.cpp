@@ -1,192 +1,286 @@
 #include "realtime.h"
 #include "settings.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+// ======================================================================
+// Uniform handles (resolved once at link time)
+// ======================================================================
+
+void PhongUniforms::load(const ShaderReflection &r) {
+    materials   = r.uniform("materials");
+    sampler     = r.uniform("sampler");
+    heightMap   = r.uniform("heightMap");
+    bumpScale   = r.uniform("bumpScale");
+
+    shadowSize  = r.uniform("shadowSize");
+    shadowTaps  = r.uniform("shadowTaps");
+
+    shadowMaps    = r.uniform("shadowMaps");
+    lightMVPs      = r.uniform("lightMVPs");
+    layerRegions   = r.uniform("layerRegions");
+    shadowLayers   = r.uniform("shadowLayers");
+    layerPoints    = r.uniform("layerPoints");
+    cascadeSplits  = r.uniform("cascadeSplits");
+
+    shadowMoments   = r.uniform("shadowMoments");
+    evsmExponents   = r.uniform("evsmExponents");
+
+    lightData     = r.uniform("lightData");
+    clusterRanges = r.uniform("clusterRanges");
+    clusterLights = r.uniform("clusterLights");
+    clusterGrid   = r.uniform("clusterGrid");
+    clusterScale  = r.uniform("clusterScale");
+    clusterDepth  = r.uniform("clusterDepth");
+
+    objectRanges  = r.uniform("objectRanges");
+    objectLights  = r.uniform("objectLights");
+
+    // The camera comes from a per-frame uniform buffer
+    r.bindBlock("Camera", CAMERA_BLOCK_BINDING);
+}
+
 // ======================================================================
-// Lighting + material uniforms helper (Phong)
+// Per-frame data (camera block + light table)
 // ======================================================================
 
-void Realtime::shader(const RenderShapeData& shape,
-                      const std::vector<SceneLightData>& lights)
-{
-    SceneGlobalData global   = m_renderData.globalData;
-    SceneMaterial   material = shape.primitive.material;
-
-    glm::vec3 Ka = global.ka * glm::vec3(material.cAmbient);
-    glm::vec3 Kd = global.kd * glm::vec3(material.cDiffuse);
-    glm::vec3 Ks = global.ks * glm::vec3(material.cSpecular);
-
-    glUniform3fv(glGetUniformLocation(m_shader, "ka"), 1, &Ka[0]);
-    glUniform3fv(glGetUniformLocation(m_shader, "kd"), 1, &Kd[0]);
-    glUniform3fv(glGetUniformLocation(m_shader, "ks"), 1, &Ks[0]);
-    glUniform1f(glGetUniformLocation(m_shader, "shininess"),
-                material.shininess);
-
-    // Camera position - keep your working version
-    glm::vec3 camPos = glm::vec3(m_camera.pos);
-    glUniform3fv(glGetUniformLocation(m_shader, "cameraPos"),
-                 1, glm::value_ptr(camPos));
-
-    // Upload lights exactly as before
-    int n = std::min<int>(lights.size(), numLights);
-    for (int i = 0; i < n; i++) {
-        const SceneLightData &light = lights[i];
-        std::string base = "lights[" + std::to_string(i) + "].";
-
-        glUniform1i(glGetUniformLocation(m_shader, (base + "type").c_str()),
-                    int(light.type));
-
-        glm::vec3 color = glm::vec3(light.color);
-        glUniform3fv(glGetUniformLocation(m_shader, (base + "color").c_str()),
-                     1, &color[0]);
-
-        glm::vec3 pos = glm::vec3(light.pos);
-        glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
-        glUniform3fv(glGetUniformLocation(m_shader, (base + "pos").c_str()),
-                     1, &pos[0]);
-        glUniform3fv(glGetUniformLocation(m_shader, (base + "dir").c_str()),
-                     1, &dir[0]);
-
-        glm::vec3 function = glm::vec3(light.function);
-        glUniform3fv(glGetUniformLocation(m_shader, (base + "function").c_str()),
-                     1, &function[0]);
-
-        glUniform1f(glGetUniformLocation(m_shader, (base + "angle").c_str()),
-                    light.angle);
-        glUniform1f(glGetUniformLocation(m_shader, (base + "penumbra").c_str()),
-                    light.penumbra);
+void Realtime::initializeUniformBlocks() {
+    glGenBuffers(1, &m_camera_ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_camera_ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, m_camera_ubo);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    m_camera_dirty = true;
+    m_lights_dirty = true;
+}
+
+void Realtime::uploadCamera(const glm::mat4 &view, const glm::mat4 &proj) {
+    CameraBlock block;
+    block.view      = view;
+    block.proj      = proj;
+    block.cameraPos = glm::vec4(glm::vec3(m_camera.pos), 1.f);
+
+    // Skip the upload entirely while the camera is still
+    if (!m_camera_dirty && memcmp(&block, &m_camera_block, sizeof(CameraBlock)) == 0) {
+        return;
     }
+
+    m_camera_block = block;
+    m_camera_dirty = false;
+
+    glBindBuffer(GL_UNIFORM_BUFFER, m_camera_ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &m_camera_block);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
 }
 
+void Realtime::uploadLights() {
+    if (!m_lights_dirty) return;
+    m_lights_dirty = false;
+
+    // Every light, not just the shadowed ones; clusters pick per fragment
+    std::vector<LightRecord> records(m_renderData.lights.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        const SceneLightData &light = m_renderData.lights[i];
+        LightRecord &dst = records[i];
+
+        float range  = i < m_light_ranges.size() ? m_light_ranges[i] : 0.f;
+        dst.color    = glm::vec4(glm::vec3(light.color), 1.f);
+        dst.pos      = glm::vec4(glm::vec3(light.pos), 1.f);
+        dst.dir      = glm::vec4(glm::normalize(glm::vec3(light.dir)), 0.f);
+        dst.function = glm::vec4(light.function, 0.f);
+        dst.params   = glm::vec4(float(light.type), light.angle, light.penumbra, range);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_light_buffer);
+    glBufferData(GL_TEXTURE_BUFFER,
+                 records.size() * sizeof(LightRecord),
+                 records.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    m_clusters_dirty = true;
+    m_object_lights_dirty = true;
+}
 
 // ======================================================================
-// paintGeometry  (Phong + optional soft shadows + bump mapping)
+// Per-frame state shared by the forward and deferred paths
 // ======================================================================
 
-void Realtime::paintGeometry() {
-    glUseProgram(m_shader);
-
+void Realtime::prepareFrame() {
     int fbWidth  = width()  * m_devicePixelRatio;
     int fbHeight = height() * m_devicePixelRatio;
     float aspect = float(fbWidth) / float(fbHeight);
 
     // Camera transforms
-    glm::mat4 view = m_camera.getViewMatrix();
-    glm::mat4 proj = m_camera.getProjectionMatrix(
+    m_view = m_camera.getViewMatrix();
+    m_proj = m_camera.getProjectionMatrix(
         aspect, settings.nearPlane, settings.farPlane
         );
 
-    m_view = view;
-    m_proj = proj;
+    // Camera block and light table: re-uploaded only when they change
+    uploadCamera(m_view, m_proj);
+    uploadLights();
 
-    glUniformMatrix4fv(glGetUniformLocation(m_shader, "view"),
-                       1, GL_FALSE, &m_view[0][0]);
-    glUniformMatrix4fv(glGetUniformLocation(m_shader, "proj"),
-                       1, GL_FALSE, &m_proj[0][0]);
+    assignLightClusters(m_view, m_proj);
+    assignObjectLights();
+}
 
-    glm::vec3 camPos = glm::vec3(m_camera.pos);
-    glUniform3fv(glGetUniformLocation(m_shader, "cameraPos"),
-                 1, glm::value_ptr(camPos));
+void Realtime::bindLighting(const PhongUniforms &u, uint32_t features) {
+    int fbWidth  = width()  * m_devicePixelRatio;
+    int fbHeight = height() * m_devicePixelRatio;
 
     // ===============================================================
-    // SHADOWS — FIXED TEXTURE UNIT ASSIGNMENT
+    // CLUSTERED LIGHTS — light table + per-cluster index lists
     // ===============================================================
 
-    bool useDepthShadows = (settings.extraCredit4 != 0);
+    const float clusterNear = std::max(settings.nearPlane, 0.01f);
+    const float clusterFar  = std::max(settings.farPlane, clusterNear + 0.01f);
+    const float logRatio    = std::log(clusterFar / clusterNear);
 
-    glUniform1i(glGetUniformLocation(m_shader, "shadowSize"),
-                useDepthShadows ? m_shadow_size : 0);
-    glUniform1i(glGetUniformLocation(m_shader, "softShadows"),
-                useDepthShadows ? 1 : 0);
+    glUniform3i(u.clusterGrid, CLUSTER_X, CLUSTER_Y, CLUSTER_Z);
+    glUniform2f(u.clusterScale, float(CLUSTER_X) / fbWidth, float(CLUSTER_Y) / fbHeight);
+    glUniform2f(u.clusterDepth, CLUSTER_Z / logRatio, CLUSTER_Z * std::log(clusterNear) / logRatio);
 
-    int nLights = std::min<int>(numLights, m_renderData.lights.size());
-    glUniform1i(glGetUniformLocation(m_shader, "numLights"), nLights);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_light_texture);
+    glUniform1i(u.lightData, LIGHT_UNIT);
 
-    int SHADOW_BASE = 1;  // shadow maps will use texture units 1,2,3,...
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_cluster_texture);
+    glUniform1i(u.clusterRanges, CLUSTER_UNIT);
 
-    if (useDepthShadows) {
-        for (int i = 0; i < nLights; i++) {
+    glActiveTexture(GL_TEXTURE0 + CLUSTER_LIGHTS_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_cluster_index_texture);
+    glUniform1i(u.clusterLights, CLUSTER_LIGHTS_UNIT);
 
-            // ---- upload light MVP ----
-            std::string mvpName = "lightMVPs[" + std::to_string(i) + "]";
-            glUniformMatrix4fv(glGetUniformLocation(m_shader, mvpName.c_str()),
-                               1, GL_FALSE, &m_light_MVPs[i][0][0]);
+    glActiveTexture(GL_TEXTURE0 + OBJECT_RANGE_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_object_range_texture);
+    glUniform1i(u.objectRanges, OBJECT_RANGE_UNIT);
 
-            // ---- bind shadow map texture ----
-            int unit = SHADOW_BASE + i; // texture unit 1,2,3,...
+    glActiveTexture(GL_TEXTURE0 + OBJECT_LIGHTS_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_object_light_texture);
+    glUniform1i(u.objectLights, OBJECT_LIGHTS_UNIT);
 
-            glActiveTexture(GL_TEXTURE0 + unit);
-            glBindTexture(GL_TEXTURE_2D, m_shadow_maps[i]);
+    // ===============================================================
+    // SHADOWS — FIXED TEXTURE UNIT ASSIGNMENT
+    // ===============================================================
 
-            std::string smName = "shadowMaps[" + std::to_string(i) + "]";
-            glUniform1i(glGetUniformLocation(m_shader, smName.c_str()), unit);
-        }
+    // Variants without SHADOWS have none of these uniforms
+    if (!(features & FEATURE_SHADOWS)) return;
+
+    glUniform1i(u.shadowSize, m_shadow_size);
+    glUniform1i(u.shadowTaps, settings.shadowTaps);
+    glUniform2f(u.evsmExponents, EVSM_EXPONENT, EVSM_EXPONENT);
+
+    // Shadow samplers keep their own units, so they never alias the
+    // diffuse sampler2D on unit 0
+    glUniform1i(u.shadowMaps, SHADOW_UNIT);
+    glUniform1i(u.shadowMoments, MOMENTS_UNIT);
+
+    // ---- per-layer MVPs, each light's first layer, cascade ranges ----
+    // (SHADOWED_LIGHTS entries, encoded in the feature mask)
+    const GLsizei shadowed = (features >> FEATURE_SHADOWED_SHIFT) & 0xF;
+    GLint layers[8];
+    std::fill(std::begin(layers), std::end(layers), -1);
+    std::copy_n(m_light_shadow_layers.begin(),
+                std::min<size_t>(m_light_shadow_layers.size(), 8), layers);
+
+    // Per layer: uv corner, rendered fraction (tier) and array slice
+    glm::vec4 regions[MAX_SHADOW_LAYERS];
+    for (size_t layer = 0; layer < m_shadow_layer_tiers.size(); layer++) {
+        glm::vec2 origin = glm::vec2(shadowLayerOrigin(int(layer))) / float(m_shadow_size);
+        regions[layer] = glm::vec4(origin, 1.f / float(1 << m_shadow_layer_tiers[layer]),
+                                   float(m_shadow_layer_slices[layer]));
+    }
+
+    GLsizei layerCount = static_cast<GLsizei>(m_rendered_MVPs.size());
+    glUniformMatrix4fv(u.lightMVPs, layerCount, GL_FALSE, &m_rendered_MVPs[0][0][0]);
+    glUniform4fv(u.layerRegions, layerCount, &regions[0][0]);
+    glUniform1iv(u.shadowLayers, shadowed, layers);
+    glUniform4fv(u.layerPoints, layerCount, &m_rendered_points[0][0]);
+    glUniform4fv(u.cascadeSplits, 1, &m_cascade_splits[0]);
+
+    // ---- every shadow map is one layer of the same array ----
+    glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_array);
+
+    // ---- prefiltered moments, same layer layout ----
+    if (features & FEATURE_EVSM) {
+        glActiveTexture(GL_TEXTURE0 + MOMENTS_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_moments);
     }
+}
 
+void Realtime::bindSurface(const PhongUniforms &u) {
     // ===============================================================
-    // --- BUMP MAP (height map) — uses unit AFTER shadow maps -------
+    // --- BUMP MAP (height map) — unit after the shadow array -------
     // ===============================================================
 
     if (m_height_map != 0) {
-        int BUMP_UNIT = SHADOW_BASE + nLights;  // e.g., if 2 lights → unit 3
-
         glActiveTexture(GL_TEXTURE0 + BUMP_UNIT);
         glBindTexture(GL_TEXTURE_2D, m_height_map);
 
-        glUniform1i(glGetUniformLocation(m_shader, "heightMap"), BUMP_UNIT);
+        glUniform1i(u.heightMap, BUMP_UNIT);
 
         float bumpScale = 2.f;
-        glUniform1f(glGetUniformLocation(m_shader, "bumpScale"), bumpScale);
+        glUniform1f(u.bumpScale, bumpScale);
     }
 
     // ===============================================================
-    // DRAW ANALYTIC PRIMITIVES (unchanged, but texture-unit–safe)
+    // MATERIAL TABLE — buffer texture on a unit past shadows/bump
     // ===============================================================
 
-    size_t objIdx = 0;
-    for (const RenderShapeData &shape : m_renderData.shapes) {
-        if (objIdx >= m_objects.size()) break;
-
-        GLShape &obj = m_objects[objIdx++];
-
-        m_model       = obj.model;
-        m_normalModel = glm::transpose(glm::inverse(obj.model));
+    glActiveTexture(GL_TEXTURE0 + MATERIAL_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, m_material_texture);
+    glUniform1i(u.materials, MATERIAL_UNIT);
+}
 
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "model"),
-                           1, GL_FALSE, &m_model[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(m_shader, "normalModel"),
-                           1, GL_FALSE, &m_normalModel[0][0]);
+// Every batch with the variant of default.frag (or gbuffer.frag) that
+// matches its texture; uniforms are set whenever the program changes
+void Realtime::drawBatches(bool gbuffer, uint32_t features) {
+    GLuint current = 0;
+
+    m_arena.bind();
+    for (const DrawBatch &batch : m_batches) {
+        GLuint diffuseTex = m_textures.texture(batch.texture);
+        uint32_t batchFeatures = features | (diffuseTex != 0 ? FEATURE_TEXTURE : 0u);
+        const PhongProgram &variant = gbuffer ? gbufferProgram(batchFeatures)
+                                              : phongProgram(batchFeatures);
+
+        if (variant.program != current) {
+            current = variant.program;
+            glUseProgram(current);
+            if (!gbuffer) bindLighting(variant.uniforms, batchFeatures);
+            bindSurface(variant.uniforms);
+            glUniform1i(variant.uniforms.sampler, 0);
+        }
 
         // ===========================================================
         // DIFFUSE / ALBEDO TEXTURE — ALWAYS TEXTURE UNIT 0
         // ===========================================================
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_mesh_texture);
-        glUniform1i(glGetUniformLocation(m_shader, "sampler"), 0);
-
-        if (shape.primitive.material.textureMap.isUsed) {
-            glUniform1i(glGetUniformLocation(m_shader, "useTexture"), 1);
-
-            QImage img = shape.primitive.material.textureMap.texture;
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA,
-                         img.width(), img.height(),
-                         0, GL_RGBA, GL_UNSIGNED_BYTE, img.bits());
-        } else {
-            glUniform1i(glGetUniformLocation(m_shader, "useTexture"), 0);
-        }
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // material + lights
-        shader(shape, m_renderData.lights);
+        glBindTexture(GL_TEXTURE_2D, diffuseTex);
 
         // === DRAW ===
-        glBindVertexArray(obj.vao);
-        glDrawArrays(obj.mode, 0, obj.count);
+        m_arena.draw(GL_TRIANGLES, batch.firstCommand, batch.commandCount);
     }
+    m_arena.unbind();
+}
+
+// ======================================================================
+// paintGeometry  (Phong + optional soft shadows + bump mapping)
+// ======================================================================
+
+void Realtime::paintGeometry() {
+    prepareFrame();
+    drawBatches(false, frameFeatures());
 
-    glBindVertexArray(0);
     glUseProgram(0);
 }
 
@@ -5,16 +5,15 @@
 #include <QKeyEvent>
 #include <iostream>
 #include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <map>
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "settings.h"
 #include "utils/sceneparser.h"
-#include "shapes/Cube.h"
-#include "shapes/Cone.h"
-#include "shapes/Sphere.h"
-#include "shapes/Cylinder.h"
 
 // ======================================================================
 // Constructor
@@ -23,6 +22,7 @@
 Realtime::Realtime(QWidget *parent)
     : QOpenGLWidget(parent)
 {
+    m_startupTimer.start();
     m_prev_mouse_pos = glm::vec2(size().width()/2, size().height()/2);
     setMouseTracking(true);
     setFocusPolicy(Qt::StrongFocus);
@@ -41,25 +41,46 @@ Realtime::Realtime(QWidget *parent)
 
 void Realtime::finish() {
     killTimer(m_timer);
+    if (m_scene_job.valid()) m_scene_job.wait();
     makeCurrent();
 
-    // --- Analytic primitive VAOs/VBOs ---
-    for (auto &obj : m_objects) {
-        obj.destroy();
-    }
+    // --- Geometry arena (tessellations, OBJ vertices, instances) ---
     m_objects.clear();
-
-    // --- Trimesh VAOs/VBOs (if used) ---
-    for (const auto &pair : m_meshes) {
-        if (pair.second.vbo) glDeleteBuffers(1, &pair.second.vbo);
-        if (pair.second.vao) glDeleteVertexArrays(1, &pair.second.vao);
-    }
+    m_batches.clear();
     m_meshes.clear();
+    m_shape_ranges.clear();
+    m_shape_bounds.clear();
+    m_instance_bounds.clear();
+    m_instance_models.clear();
+    m_arena.destroy();
+
+    // --- Material table ---
+    if (m_material_texture) glDeleteTextures(1, &m_material_texture);
+    if (m_material_buffer)  glDeleteBuffers(1, &m_material_buffer);
+
+    // --- Diffuse textures ---
+    m_textures.clear();
 
     // --- Shader programs ---
-    if (m_shader)         glDeleteProgram(m_shader);
-    if (m_texture_shader) glDeleteProgram(m_texture_shader);
-    if (m_shadow_shader)  glDeleteProgram(m_shadow_shader);
+    m_phong_programs.clear();
+    m_gbuffer_programs.clear();
+    m_deferred_programs.clear();
+    m_program_cache.clear();    // also owns the blit, shadow and moments programs
+
+    // --- Camera uniform buffer ---
+    if (m_camera_ubo) glDeleteBuffers(1, &m_camera_ubo);
+
+    // --- Clustered light tables ---
+    if (m_light_texture)         glDeleteTextures(1, &m_light_texture);
+    if (m_light_buffer)          glDeleteBuffers(1, &m_light_buffer);
+    if (m_cluster_texture)       glDeleteTextures(1, &m_cluster_texture);
+    if (m_cluster_buffer)        glDeleteBuffers(1, &m_cluster_buffer);
+    if (m_cluster_index_texture) glDeleteTextures(1, &m_cluster_index_texture);
+    if (m_cluster_index_buffer)  glDeleteBuffers(1, &m_cluster_index_buffer);
+    if (m_object_range_texture)  glDeleteTextures(1, &m_object_range_texture);
+    if (m_object_range_buffer)   glDeleteBuffers(1, &m_object_range_buffer);
+    if (m_object_light_texture)  glDeleteTextures(1, &m_object_light_texture);
+    if (m_object_light_buffer)   glDeleteBuffers(1, &m_object_light_buffer);
 
     // --- Fullscreen quad / FBO (your FBO for paintTexture) ---
     if (m_fullscreen_vao) glDeleteVertexArrays(1, &m_fullscreen_vao);
@@ -68,14 +89,18 @@ void Realtime::finish() {
     if (m_fbo_texture) glDeleteTextures(1, &m_fbo_texture);
     if (m_fbo_depth)   glDeleteTextures(1, &m_fbo_depth);
     if (m_fbo)         glDeleteFramebuffers(1, &m_fbo);
+    deleteGBuffer();
 
     // --- Shadow resources ---
-    if (!m_shadow_maps.empty()) {
-        glDeleteTextures(static_cast<GLsizei>(m_shadow_maps.size()),
-                         m_shadow_maps.data());
-        m_shadow_maps.clear();
+    if (m_shadow_array) {
+        glDeleteTextures(1, &m_shadow_array);
+        m_shadow_array = 0;
     }
     if (m_fbo_shadow) glDeleteFramebuffers(1, &m_fbo_shadow);
+    if (m_shadow_moments)       glDeleteTextures(1, &m_shadow_moments);
+    if (m_moments_scratch)      glDeleteTextures(1, &m_moments_scratch);
+    if (m_fbo_moments)          glDeleteFramebuffers(1, &m_fbo_moments);
+    if (m_shadow_depth_sampler) glDeleteSamplers(1, &m_shadow_depth_sampler);
 
     // --- Bump mapping height map ---
     if (m_height_map) {
@@ -109,83 +134,6 @@ void Realtime::initCameraPath() {
     m_followingPath = false;
 }
 
-// ======================================================================
-// VAO/VBO builder for analytic primitives
-// ======================================================================
-
-void Realtime::buildShape(GLShape &shape,
-                          const std::vector<float> &data,
-                          const glm::mat4 &M)
-{
-    shape.destroy();
-
-    if (data.empty()) {
-        shape.count = 0;
-        shape.model = M;
-        return;
-    }
-
-    // ------------------------------------------------------------
-    // Detect how many floats per vertex we actually have
-    //  - 8: pos(3) + nor(3) + uv(2)
-    //  - 6: pos(3) + nor(3)
-    //  - 3: pos(3)
-    // ------------------------------------------------------------
-    int floatsPerVertex = 0;
-
-    if (data.size() % 8 == 0) {
-        floatsPerVertex = 8;
-    } else if (data.size() % 6 == 0) {
-        floatsPerVertex = 6;
-    } else if (data.size() % 3 == 0) {
-        floatsPerVertex = 3;
-    } else {
-        // Fallback: assume pos+normal
-        floatsPerVertex = 6;
-    }
-
-    shape.count = static_cast<int>(data.size() / floatsPerVertex);
-
-    glGenVertexArrays(1, &shape.vao);
-    glGenBuffers(1, &shape.vbo);
-
-    glBindVertexArray(shape.vao);
-    glBindBuffer(GL_ARRAY_BUFFER, shape.vbo);
-    glBufferData(GL_ARRAY_BUFFER,
-                 data.size() * sizeof(float),
-                 data.data(),
-                 GL_STATIC_DRAW);
-
-    GLsizei stride = floatsPerVertex * sizeof(float);
-
-    // --- Position (always present) ---
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE,
-                          stride, (void*)0);
-
-    // --- Normal (if present) ---
-    if (floatsPerVertex >= 6) {
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE,
-                              stride, (void*)(3 * sizeof(float)));
-    } else {
-        glDisableVertexAttribArray(1);
-    }
-
-    // --- UV (if present) ---
-    if (floatsPerVertex == 8) {
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE,
-                              stride, (void*)(6 * sizeof(float)));
-    } else {
-        glDisableVertexAttribArray(2);
-    }
-
-    glBindVertexArray(0);
-    shape.model = M;
-}
-
-
 // ======================================================================
 // initializeGL
 // ======================================================================
@@ -202,6 +150,9 @@ void Realtime::initializeGL() {
                   << glewGetErrorString(err) << std::endl;
     }
 
+    // Start parsing the initial scene so it overlaps the GL setup below
+    sceneChanged();
+
     glEnable(GL_DEPTH_TEST);
     glEnable(GL_CULL_FACE);
 
@@ -219,21 +170,18 @@ void Realtime::initializeGL() {
     m_screen_width  = width()  * m_devicePixelRatio;
     m_screen_height = height() * m_devicePixelRatio;
 
-    // --- Main (Phong + shadow) shader ---
-    m_shader = ShaderLoader::createShaderProgram(
-        ":/resources/shaders/default.vert",
-        ":/resources/shaders/default.frag"
-        );
+    // --- Shader programs: the pass programs and the base Phong variants
+    //     are handed to the driver now and compile in parallel with the
+    //     rest of startup; paintGL polls for them (programsReady) ---
+    ShaderLoader::enableParallelCompile();
+    programsReady(0);
 
-    // --- Texture & shadow shaders (used by your FBO/shadow passes) ---
-    m_texture_shader = ShaderLoader::createShaderProgram(
-        ":/resources/shaders/texture.vert",
-        ":/resources/shaders/texture.frag"
-        );
-    m_shadow_shader = ShaderLoader::createShaderProgram(
-        ":/resources/shaders/shadowmap.vert",
-        ":/resources/shaders/shadowmap.frag"
-        );
+    // --- Camera uniform buffer, light + cluster tables ---
+    initializeUniformBlocks();
+    initializeClusters();
+
+    // --- Shared vertex/instance/indirect buffers ---
+    m_arena.init();
 
     // --- HDR pipeline, resolve into Qt's default FBO ---
     m_hdr.init(width()  * m_devicePixelRatio,
@@ -242,13 +190,11 @@ void Realtime::initializeGL() {
 
     // --- Your screen-space FBO used by paintTexture ---
     initializeFBO();
+    makeGBuffer();
 
     // --- Shadow-map FBO (depth-only) ---
     initializeShadowFBO();
 
-    // --- Trimesh texture (if you use it) ---
-    glGenTextures(1, &m_mesh_texture);
-
     // --- Bump mapping height map ---
     // Use the same image your teammate used; if it's in the Qt resource system,
     // keep the ":/resources/..." prefix; otherwise use "resources/...".
@@ -259,9 +205,6 @@ void Realtime::initializeGL() {
     // --- Camera trace & path ---
     m_camTrace.init();
     initCameraPath();
-
-    // Load initial scene (also sets up shadow depth textures)
-    sceneChanged();
 }
 
 
@@ -276,6 +219,15 @@ void Realtime::paintGL() {
     int fbWidth  = width()  * m_devicePixelRatio;
     int fbHeight = height() * m_devicePixelRatio;
 
+    // Until the scene's first frame has its programs linked, present the
+    // clear colour instead of waiting on the compiler; the timer polls again
+    if (!m_scene_frame_ready && !programsReady(frameFeatures())) {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        return;
+    }
+    loadPassPrograms();
+
     // Keep "teammate-style" camera values in sync with Camera object
     m_camPos  = glm::vec3(m_camera.pos);
     m_camLook = glm::vec3(m_camera.look);
@@ -285,11 +237,13 @@ void Realtime::paintGL() {
     // 1) Shadow pass ONLY when using depth-map soft shadows
     //    (settings.extraCredit4 == 1).
     //    When off, we entirely skip the depth shadow pipeline and fall
-    //    back to "original" shading.
+    //    back to "original" shading. Maps are cached, so a static scene
+    //    costs no shadow draws once every map is current.
     // ------------------------------------------------------------------
     if (settings.extraCredit4) {
         computeLightMVPs();
         paintShadows();
+        if (settings.varianceShadows) filterShadowMoments();
     }
 
     // 2) Main scene pass (HDR FBO or your color+depth FBO)
@@ -303,7 +257,11 @@ void Realtime::paintGL() {
     glEnable(GL_DEPTH_TEST);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    paintGeometry();
+    if (settings.deferredShading) {
+        paintDeferred();
+    } else {
+        paintGeometry();
+    }
 
     // View/proj from Camera for the camera trace
     glm::mat4 view = m_camera.getViewMatrix();
@@ -335,6 +293,18 @@ void Realtime::paintGL() {
         // Your FBO blit (uses m_texture_shader + fullscreen quad)
         paintTexture(m_fbo_texture, m_fbo_depth);
     }
+
+    if (!m_scene_applied) return;
+    m_scene_frame_ready = true;
+
+    if (m_startupTimer.isValid()) {
+        // Wait for the GPU once so the figure includes the driver's own work
+        glFinish();
+        std::cout << "Time to first frame: " << m_startupTimer.elapsed() << " ms ("
+                  << ProgramBinaryCache::hits() << " programs from the binary cache, "
+                  << ProgramBinaryCache::misses() << " compiled)" << std::endl;
+        m_startupTimer.invalidate();
+    }
 }
 
 // ======================================================================
@@ -361,6 +331,10 @@ void Realtime::resizeGL(int w, int h) {
     m_fbo_height = fbHeight;
     makeFBO();
 
+    // G-buffer tracks the same size
+    deleteGBuffer();
+    makeGBuffer();
+
     // Resize HDR FBO as well
     m_hdr.resize(fbWidth, fbHeight, m_defaultFBO);
 }
@@ -372,13 +346,46 @@ void Realtime::resizeGL(int w, int h) {
 void Realtime::sceneChanged() {
     if (settings.sceneFilePath.empty()) return;
 
-    RenderData newData;
-    if (!SceneParser::parse(settings.sceneFilePath, newData)) {
+    // Parse on a worker thread (the parser touches no GL); timerEvent
+    // applies the result. Replacing a parse still in flight waits for it.
+    m_scene_job = std::async(std::launch::async, [path = settings.sceneFilePath]() -> std::optional<RenderData> {
+        RenderData data;
+        if (!SceneParser::parse(path, data)) return std::nullopt;
+        return data;
+    });
+}
+
+void Realtime::pollSceneJob() {
+    if (!m_scene_job.valid()
+        || m_scene_job.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return;
+    }
+
+    std::optional<RenderData> parsed = m_scene_job.get();
+    if (!parsed) {
         std::cerr << "ERROR: Failed to load scene\n";
         return;
     }
 
-    m_renderData = std::move(newData);
+    makeCurrent();
+    applyScene(std::move(*parsed));
+}
+
+void Realtime::applyScene(RenderData &&data) {
+    m_renderData = std::move(data);
+    m_lights_dirty = true;
+
+    // Upload each unique diffuse texture once; shapes keep a handle
+    m_textures.clear();
+    for (RenderShapeData &shape : m_renderData.shapes) {
+        shape.texture = m_textures.acquire(shape.primitive.material.textureMap);
+        for (RenderSubmesh &submesh : shape.submeshes) {
+            submesh.texture = m_textures.acquire(submesh.material.textureMap);
+        }
+    }
+
+    // Copy OBJ vertices into the geometry arena once per scene
+    uploadMeshes();
 
     // Camera object
     m_camera = Camera(m_renderData.cameraData);
@@ -388,12 +395,18 @@ void Realtime::sceneChanged() {
     m_camLook = glm::vec3(m_renderData.cameraData.look);
     m_camUp   = glm::normalize(glm::vec3(m_renderData.cameraData.up));
 
-    // Rebuild analytic primitive VAOs
+    // Rebuild instance + indirect command buffers
     rebuildScene();
 
     // Re-init shadow depth textures based on lights
     initializeShadowDepths();
 
+    // Start this scene's permutations now; paintGL presents the clear
+    // colour until they link instead of blocking on them
+    m_scene_applied = true;
+    m_scene_frame_ready = false;
+    programsReady(frameFeatures());
+
     update();
 }
 
@@ -403,42 +416,212 @@ void Realtime::settingsChanged() {
 }
 
 void Realtime::rebuildScene() {
-    for (auto &o : m_objects) o.destroy();
     m_objects.clear();
+    m_batches.clear();
+    m_scene_bounds = AABB{};
+    m_instance_bounds.clear();
+    m_instance_models.clear();
+    m_geometry_revision++;
 
     if (m_renderData.shapes.empty()) return;
 
-    int p1 = settings.shapeParameter1;
-    int p2 = settings.shapeParameter2;
-
-    for (const auto &s : m_renderData.shapes) {
-        std::vector<float> data;
+    uploadMaterials();
 
-        switch (s.primitive.type) {
-        case PrimitiveType::PRIMITIVE_CUBE: {
-            Cube c; c.updateParams(p1); data = c.generateShape(); break;
+    // Tessellations for other slider values free their arena space
+    for (auto it = m_meshes.begin(); it != m_meshes.end(); ) {
+        if (it->first == meshKey(it->first.type)) {
+            ++it;
+            continue;
         }
-        case PrimitiveType::PRIMITIVE_CONE: {
-            Cone c; c.updateParams(p1, p2); data = c.generateShape(); break;
+        m_arena.release(it->second.range);
+        it = m_meshes.erase(it);
+    }
+
+    // ------------------------------------------------------------
+    // Group analytic primitives by tessellation (PrimitiveMeshKey)
+    // and diffuse texture; each group becomes one instanced draw.
+    // OBJ meshes draw each material's index range of their own
+    // arena range as a single instance.
+    // ------------------------------------------------------------
+    std::unordered_map<PrimitiveMeshKey,
+                       std::map<int, std::vector<InstanceData>>,
+                       PrimitiveMeshKeyHash> groups;
+    std::vector<PrimitiveMeshKey> groupKeys;
+
+    std::vector<InstanceData> instances;
+    instances.reserve(m_renderData.shapes.size());
+
+    const AABB unitCube{ glm::vec3(-0.5f), glm::vec3(0.5f) };
+
+    for (size_t i = 0; i < m_renderData.shapes.size(); i++) {
+        const RenderShapeData &s = m_renderData.shapes[i];
+
+        InstanceData instance;
+        instance.model       = s.ctm;
+        instance.normalModel = glm::transpose(glm::inverse(glm::mat3(s.ctm)));
+        instance.material    = m_material_slots[i];
+
+        if (s.primitive.type == PrimitiveType::PRIMITIVE_MESH) {
+            if (i >= m_shape_ranges.size() || m_shape_ranges[i].indices.count == 0) continue;
+            const MeshRange &range = m_shape_ranges[i];
+            AABB bounds = m_shape_bounds[i].transformed(s.ctm);
+            m_scene_bounds.extend(bounds);
+
+            GLShape shape;
+            shape.mesh     = range;
+            shape.texture  = s.texture;
+            shape.material = instance.material;
+            if (s.submeshes.empty()) {
+                shape.baseInstance = static_cast<int>(instances.size());
+                shape.instances    = 1;
+                instances.push_back(instance);
+                m_instance_bounds.push_back(bounds);
+                m_objects.push_back(shape);
+                continue;
+            }
+
+            for (size_t j = 0; j < s.submeshes.size(); j++) {
+                const RenderSubmesh &submesh = s.submeshes[j];
+                if (submesh.firstIndex + uint64_t(submesh.indexCount) > uint64_t(range.indices.count)) continue;
+
+                instance.material         = m_material_slots[i] + static_cast<GLint>(j);
+                shape.mesh.indices.first  = range.indices.first + static_cast<GLint>(submesh.firstIndex);
+                shape.mesh.indices.count  = static_cast<GLsizei>(submesh.indexCount);
+                shape.texture             = submesh.texture;
+                shape.material            = instance.material;
+                shape.baseInstance        = static_cast<int>(instances.size());
+                shape.instances           = 1;
+                instances.push_back(instance);
+                m_instance_bounds.push_back(bounds);
+                m_objects.push_back(shape);
+            }
+            continue;
         }
-        case PrimitiveType::PRIMITIVE_SPHERE: {
-            Sphere c; c.updateParams(p1, p2); data = c.generateShape(); break;
+
+        // Analytic primitives all fit the unit cube centered at the origin
+        m_scene_bounds.extend(unitCube.transformed(s.ctm));
+
+        PrimitiveMeshKey key = meshKey(s.primitive.type);
+        auto &byTexture = groups[key];
+        if (byTexture.empty()) groupKeys.push_back(key);
+        byTexture[s.texture].push_back(instance);
+    }
+
+    // Generate any tessellation not already resident in the arena
+    std::vector<PrimitiveMeshKey> pending;
+    for (const PrimitiveMeshKey &key : groupKeys) {
+        if (!m_meshes.count(key)) pending.push_back(key);
+    }
+    tessellateMeshes(pending);
+
+    for (const PrimitiveMeshKey &key : groupKeys) {
+        const PrimitiveMeshGL &mesh = getMesh(key);
+        if (mesh.range.indices.count == 0) continue;
+
+        for (const auto &[texture, group] : groups[key]) {
+            GLShape shape;
+            shape.mesh         = mesh.range;
+            shape.instances    = static_cast<int>(group.size());
+            shape.baseInstance = static_cast<int>(instances.size());
+            shape.texture      = texture;
+            shape.material     = group.front().material;
+            instances.insert(instances.end(), group.begin(), group.end());
+            for (const InstanceData &instance : group) {
+                m_instance_bounds.push_back(unitCube.transformed(instance.model));
+            }
+            m_objects.push_back(shape);
         }
-        case PrimitiveType::PRIMITIVE_CYLINDER: {
-            Cylinder c; c.updateParams(p1, p2); data = c.generateShape(); break;
+    }
+
+    // ------------------------------------------------------------
+    // Indirect commands, sorted so each texture is one batch and
+    // draws sharing a material sit next to each other inside it
+    // ------------------------------------------------------------
+    std::stable_sort(m_objects.begin(), m_objects.end(),
+                     [](const GLShape &a, const GLShape &b) {
+                         if (a.texture != b.texture) return a.texture < b.texture;
+                         return a.material < b.material;
+                     });
+
+    std::vector<DrawElementsIndirectCommand> commands;
+    commands.reserve(m_objects.size());
+    for (const GLShape &obj : m_objects) {
+        if (m_batches.empty() || m_batches.back().texture != obj.texture) {
+            m_batches.push_back({ obj.texture, static_cast<int>(commands.size()), 0 });
         }
-        case PrimitiveType::PRIMITIVE_MESH: {
-            data = s.triData; break;
+        m_batches.back().commandCount++;
+
+        commands.push_back({ static_cast<GLuint>(obj.mesh.indices.count),
+                             static_cast<GLuint>(obj.instances),
+                             static_cast<GLuint>(obj.mesh.indices.first),
+                             obj.mesh.vertices.first,
+                             static_cast<GLuint>(obj.baseInstance) });
+    }
+
+    m_instance_models.reserve(instances.size());
+    for (size_t k = 0; k < instances.size(); k++) {
+        instances[k].instance = static_cast<GLint>(k);
+        m_instance_models.push_back(instances[k].model);
+    }
+    m_object_lights_dirty = true;
+
+    m_arena.setInstances(instances);
+    m_arena.setCommands(commands);
+}
+
+// ======================================================================
+// Material table (one entry per RenderShapeData, or per submesh of an
+// OBJ shape; read by default.frag). Shapes whose materials match bit for
+// bit share one run of slots.
+// ======================================================================
+
+void Realtime::uploadMaterials() {
+    const SceneGlobalData &global = m_renderData.globalData;
+
+    // 3 RGBA32F texels per material: (ka, shininess), (kd, 0), (ks, 0)
+    std::vector<glm::vec4> table;
+    table.reserve(m_renderData.shapes.size() * 3);
+    auto append = [&](const SceneMaterial &material) {
+        table.emplace_back(global.ka * glm::vec3(material.cAmbient),  material.shininess);
+        table.emplace_back(global.kd * glm::vec3(material.cDiffuse),  0.f);
+        table.emplace_back(global.ks * glm::vec3(material.cSpecular), 0.f);
+    };
+
+    // Texels of a shape's run -> its first slot
+    std::unordered_map<std::string, int> runs;
+
+    m_material_slots.clear();
+    m_material_slots.reserve(m_renderData.shapes.size());
+    for (const RenderShapeData &shape : m_renderData.shapes) {
+        const size_t first = table.size();
+        if (shape.submeshes.empty()) {
+            append(shape.primitive.material);
         }
-        default:
-            // PRIMITIVE_MESH handled elsewhere via m_meshes
-            continue;
+        for (const RenderSubmesh &submesh : shape.submeshes) {
+            append(submesh.material);
         }
 
-        GLShape shape;
-        buildShape(shape, data, s.ctm);
-        m_objects.push_back(shape);
+        std::string key(reinterpret_cast<const char*>(&table[first]), (table.size() - first) * sizeof(glm::vec4));
+        auto [it, inserted] = runs.emplace(std::move(key), static_cast<int>(first / 3));
+        if (!inserted) table.resize(first);   // reuse the identical run
+        m_material_slots.push_back(it->second);
     }
+
+    if (!m_material_buffer) {
+        glGenBuffers(1, &m_material_buffer);
+        glGenTextures(1, &m_material_texture);
+    }
+
+    glBindBuffer(GL_TEXTURE_BUFFER, m_material_buffer);
+    glBufferData(GL_TEXTURE_BUFFER,
+                 table.size() * sizeof(glm::vec4),
+                 table.data(),
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_BUFFER, m_material_texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_material_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
 }
 
 // ======================================================================
@@ -484,6 +667,8 @@ void Realtime::mouseMoveEvent(QMouseEvent *e) {
 // ======================================================================
 
 void Realtime::timerEvent(QTimerEvent*) {
+    pollSceneJob();
+
     float dt = m_elapsedTimer.elapsed() * 0.001f;
     m_elapsedTimer.restart();
 
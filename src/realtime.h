@@ -8,6 +8,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <future>
+#include <optional>
 #include <unordered_map>
 #include <vector>
 #include <QElapsedTimer>
@@ -18,13 +20,18 @@
 #include "utils/scenedata.h"
 #include "utils/sceneparser.h"
 #include "utils/shaderloader.h"
+#include "utils/programcache.h"
 #include "camera/camera.h"
+#include "shapes/IndexedMesh.h"
 
+#include "aabb.h"
 #include "hdr.h"
+#include "geometryarena.h"
+#include "textureregistry.h"
 #include "cameratrace.h"
 #include "camerapath.h"
 
-struct PrimitiveMeshGL { GLuint vao=0, vbo=0; GLsizei count=0; };
+struct PrimitiveMeshGL { MeshRange range; };
 struct PrimitiveMeshKey {
     PrimitiveType type; int p1; int p2;
     // define equivalence for PrimitiveMeshKeys
@@ -40,21 +47,169 @@ struct PrimitiveMeshKeyHash {
 // GLShape
 // ======================================================================
 
+// One instanced draw inside the geometry arena: a mesh range plus a run of
+// InstanceData. Draws are sorted by texture, then material, and submitted
+// in DrawBatches.
 struct GLShape {
-    GLuint vao = 0;
-    GLuint vbo = 0;
-    int count = 0;
-    GLenum mode = GL_TRIANGLES;
-    glm::mat4 model;
-
-    void destroy() {
-        if (vbo) glDeleteBuffers(1, &vbo);
-        if (vao) glDeleteVertexArrays(1, &vao);
-        vao = vbo = 0;
-        count = 0;
-    }
+    MeshRange mesh;
+    int instances = 0;
+    int baseInstance = 0;    // first entry in the arena's instance buffer
+    int texture = -1;        // TextureRegistry handle shared by all instances
+    int material = 0;        // material table slot of the first instance
+};
+
+// Consecutive indirect commands that share a diffuse texture
+struct DrawBatch {
+    int texture = -1;
+    int firstCommand = 0;
+    int commandCount = 0;
+};
+
+// ======================================================================
+// Uniform handles (resolved once from each program's ShaderReflection)
+// ======================================================================
+
+// Texture units used by default.frag (0 = diffuse)
+constexpr int SHADOW_UNIT   = 1;    // sampler2DArray, one layer per light
+constexpr int BUMP_UNIT     = 2;
+constexpr int MOMENTS_UNIT  = 3;    // sampler2DArray of prefiltered EVSM moments
+constexpr int LIGHT_UNIT          = 4;   // light table (LightRecord texels)
+constexpr int CLUSTER_UNIT        = 5;   // per cluster: first index, count
+constexpr int CLUSTER_LIGHTS_UNIT = 6;   // light indices, grouped by cluster
+constexpr int GBUFFER_ALBEDO_UNIT = 7;   // deferred lighting pass inputs
+constexpr int GBUFFER_NORMAL_UNIT = 8;
+constexpr int GBUFFER_DEPTH_UNIT  = 9;
+constexpr int MATERIAL_UNIT = 10;   // material buffer texture
+constexpr int OBJECT_RANGE_UNIT  = 11;  // per instance: first index, count
+constexpr int OBJECT_LIGHTS_UNIT = 12;  // light indices, grouped by instance
+
+// Shadow array budget: directional lights take SHADOW_CASCADES layers,
+// spot lights one, point lights six cube faces (must match shadowmap.geom
+// and default.frag). Spot and point lights render into the lower-left
+// (m_shadow_size >> tier)^2 of their layers, tier picked by the scheduler.
+// A directional light's cascades share one array slice, each in its own
+// (m_shadow_size >> CASCADE_TIER)^2 quadrant, so cascading costs no more
+// memory than the single map it replaced.
+constexpr int MAX_SHADOW_LAYERS = 32;
+constexpr int SHADOW_CASCADES   = 3;
+constexpr int SHADOW_TIERS      = 4;
+constexpr int CASCADE_TIER      = 1;
+
+// EVSM warp exponent: exp(2c) of the second moment must fit in RGBA16F
+constexpr float EVSM_EXPONENT = 5.0f;
+
+// default.vert / default.frag (and gbuffer.frag, deferred.frag)
+struct PhongUniforms {
+    GLint materials = -1;
+    GLint sampler = -1;
+    GLint heightMap = -1, bumpScale = -1;
+    GLint shadowSize = -1, shadowTaps = -1;
+    GLint lightMVPs = -1, layerRegions = -1, shadowLayers = -1;
+    GLint layerPoints = -1, cascadeSplits = -1;
+    GLint shadowMaps = -1;
+    GLint shadowMoments = -1, evsmExponents = -1;
+    GLint lightData = -1, clusterRanges = -1, clusterLights = -1;
+    GLint clusterGrid = -1, clusterScale = -1, clusterDepth = -1;
+    GLint objectRanges = -1, objectLights = -1;
+
+    void load(const ShaderReflection &r);
+};
+
+// texture.vert / deferred.frag (lighting uniforms as in default.frag)
+struct DeferredUniforms {
+    PhongUniforms lighting;
+    GLint gAlbedo = -1, gNormalMaterial = -1, gDepth = -1;
+    GLint invViewProj = -1;
+
+    void load(const ShaderReflection &r);
 };
 
+// ======================================================================
+// Shader permutations (default.frag, gbuffer.frag, deferred.frag)
+// ======================================================================
+
+// Features compiled into a variant as #defines instead of branched on at
+// run time; a feature mask keys one program in the cache
+enum ShaderFeature : uint32_t {
+    FEATURE_TEXTURE     = 1u << 0,   // USE_TEXTURE: diffuse from the bound texture (per batch)
+    FEATURE_BUMP        = 1u << 1,   // USE_BUMP: height-map normal perturbation
+    FEATURE_SHADOWS     = 1u << 2,   // SHADOWS: shadow array lookups
+    FEATURE_EVSM        = 1u << 3,   // EVSM: prefiltered moments instead of PCF
+    FEATURE_POINT       = 1u << 4,   // HAS_POINT / HAS_DIRECTIONAL / HAS_SPOT:
+    FEATURE_DIRECTIONAL = 1u << 5,   //   light types present in the scene
+    FEATURE_SPOT        = 1u << 6,
+};
+constexpr int      FEATURE_SHADOWED_SHIFT = 8;           // SHADOWED_LIGHTS (1..8) in bits 8..11
+constexpr uint32_t SURFACE_FEATURES = FEATURE_TEXTURE | FEATURE_BUMP;
+
+// One compiled variant and its uniform handles
+struct PhongProgram {
+    GLuint program = 0;
+    PhongUniforms uniforms;
+};
+
+struct DeferredProgram {
+    GLuint program = 0;
+    DeferredUniforms uniforms;
+};
+
+// shadowmap.vert / shadowmap.geom / shadowmap.frag
+struct ShadowUniforms {
+    GLint lightMVPs = -1;
+    GLint layers = -1, layerCount = -1;
+    GLint layerViewports = -1, layerSlices = -1, layerPoints = -1;
+
+    void load(const ShaderReflection &r);
+};
+
+// texture.vert / shadowmoments.frag
+struct MomentsUniforms {
+    GLint depthLayers = -1, blurSource = -1, fromDepth = -1;
+    GLint layer = -1, origin = -1, region = -1, blurRadius = -1, exponents = -1;
+
+    void load(const ShaderReflection &r);
+};
+
+// texture.vert / texture.frag
+struct TextureUniforms {
+    GLint colorTexture = -1, depthTexture = -1;
+
+    void load(const ShaderReflection &r);
+};
+
+// ======================================================================
+// Per-frame uniform blocks (std140 mirrors of default.vert/default.frag)
+// ======================================================================
+
+constexpr GLuint CAMERA_BLOCK_BINDING = 0;
+
+struct CameraBlock {
+    glm::mat4 view;
+    glm::mat4 proj;
+    glm::vec4 cameraPos;
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match std140 layout");
+
+// ======================================================================
+// Clustered lights (buffer textures read by default.frag)
+// ======================================================================
+
+// One light as 5 RGBA32F texels of the light table
+struct LightRecord {
+    glm::vec4 color;
+    glm::vec4 pos;
+    glm::vec4 dir;       // normalized
+    glm::vec4 function;
+    glm::vec4 params;    // type, angle, penumbra, range (0 = unbounded)
+};
+static_assert(sizeof(LightRecord) == 5 * sizeof(glm::vec4), "LightRecord must be 5 texels");
+
+// Froxel grid: screen tiles x depth slices (exponential between the
+// camera's near and far planes)
+constexpr int CLUSTER_X = 16;
+constexpr int CLUSTER_Y = 9;
+constexpr int CLUSTER_Z = 24;
+
 // ======================================================================
 // Realtime class
 // ======================================================================
@@ -86,9 +241,29 @@ protected:
 
 private:
     // ==== Rendering + scene ====
-    GLuint m_shader = 0;
+    ProgramCache m_program_cache;     // every compiled permutation
+    std::unordered_map<uint32_t, PhongProgram> m_phong_programs;    // default.frag, by feature mask
+    std::unordered_map<uint32_t, PhongProgram> m_gbuffer_programs;  // gbuffer.frag, SURFACE_FEATURES only
+    std::unordered_map<uint32_t, DeferredProgram> m_deferred_programs; // deferred.frag, no SURFACE_FEATURES
+    GeometryArena m_arena;            // all static vertices + instances
+    std::vector<DrawBatch> m_batches;
+    std::vector<MeshRange> m_shape_ranges;   // OBJ geometry per shape
+    std::vector<AABB> m_shape_bounds;        // object-space bounds of each OBJ shape
+    AABB m_scene_bounds;                     // world-space bounds of every drawn shape
+    std::vector<AABB> m_instance_bounds;     // world-space bounds of each arena instance
+    std::vector<glm::mat4> m_instance_models; // model matrix of each arena instance
+    GLuint m_camera_ubo = 0;
+    GLuint m_material_buffer = 0;     // per-shape/submesh material table (TBO)
+    GLuint m_material_texture = 0;
+    std::vector<int> m_material_slots;   // first material table slot of each shape
+    CameraBlock m_camera_block;       // last uploaded camera block
+    bool m_camera_dirty = true;
+    bool m_lights_dirty = true;       // set when m_renderData.lights changes
     std::vector<GLShape> m_objects;
     RenderData m_renderData;
+    std::future<std::optional<RenderData>> m_scene_job;   // parse in flight, empty on failure
+    void pollSceneJob();
+    void applyScene(RenderData &&data);
 
     // ==== Camera ====
     Camera m_camera;
@@ -97,8 +272,6 @@ private:
     glm::vec3 m_camPos;
     glm::vec3 m_camLook;
     glm::vec3 m_camUp;
-    glm::mat4 m_model = glm::mat4(1);
-    glm::mat4 m_normalModel = glm::mat4(1);
     glm::mat4 m_view  = glm::mat4(1);
     glm::mat4 m_proj  = glm::mat4(1);
 
@@ -107,6 +280,9 @@ private:
 
     // ==== Timing ====
     QElapsedTimer m_elapsedTimer;
+    QElapsedTimer m_startupTimer;          // construction to the first scene frame (invalid once reported)
+    bool m_scene_applied = false;          // a parsed scene has been uploaded
+    bool m_scene_frame_ready = false;      // a frame of that scene has drawn; until then paintGL polls programsReady
     int m_timer = 0;
     float m_devicePixelRatio = 1.f;
 
@@ -129,7 +305,8 @@ private:
     GLuint m_fbo;
     GLuint m_fbo_texture;
     GLuint m_fbo_depth;
-    GLuint m_texture_shader;
+    GLuint m_texture_shader = 0;
+    TextureUniforms m_texture_uniforms;
     int m_screen_width;
     int m_screen_height;
     int m_fbo_width;
@@ -142,38 +319,125 @@ private:
     //
     // Meshes
     //
-    GLuint m_mesh_texture;
+    TextureRegistry m_textures;
     std::unordered_map<PrimitiveMeshKey, PrimitiveMeshGL, PrimitiveMeshKeyHash> m_meshes;
-    std::vector<float> buildVertices(const ScenePrimitive& primitive) const;
-    PrimitiveMeshGL& getMesh(const ScenePrimitive& primitive);
+    PrimitiveMeshKey meshKey(PrimitiveType type) const;
+    PrimitiveMeshGL& getMesh(const PrimitiveMeshKey& key);
+
+    // CPU tessellations, kept across scene reloads and slider moves (LRU)
+    struct CachedTessellation {
+        IndexedMesh mesh;
+        uint64_t lastUse = 0;
+    };
+    std::unordered_map<PrimitiveMeshKey, CachedTessellation, PrimitiveMeshKeyHash> m_tessellations;
+    uint64_t m_tessellation_clock = 0;
+    void tessellateMeshes(const std::vector<PrimitiveMeshKey>& keys);
 
 
     //
     // Shadow mapping
     //
     GLuint m_fbo_shadow;
-    std::vector<GLuint> m_shadow_maps;    // for directional and/or spot lights
-    std::vector<glm::mat4> m_light_MVPs;  // for directional and/or spot lights
+    GLuint m_shadow_array = 0;            // GL_TEXTURE_2D_ARRAY of shadow layers
+    std::vector<int> m_light_shadow_layers; // first layer of each light (-1 = unshadowed)
+    std::vector<int> m_shadow_layer_lights; // light rendered into each layer
+    std::vector<int> m_shadow_layer_tiers;  // resolution tier of each layer (0 = full size)
+    std::vector<int> m_shadow_layer_slices; // array slice of each layer (cascades share one)
+    std::vector<int> m_shadow_layer_quadrants; // cascades: quadrant of the shared slice (0 = lower-left)
+    glm::ivec2 shadowLayerOrigin(int layer) const;   // texel corner of a layer's region
+    std::vector<float> m_light_ranges;      // spot/point: distance where light falls below the cutoff (0 = unbounded)
+    std::vector<float> m_light_shadow_far;  // spot/point: shadow far plane (point faces store it as 1.0)
+    std::vector<glm::mat4> m_light_MVPs;  // per layer: spot 1, directional SHADOW_CASCADES, point 6 faces
+    std::vector<glm::mat4> m_rendered_MVPs; // per layer: matrix the stored map was rendered with
+    std::vector<glm::vec4> m_rendered_points; // per layer: point light position and far it was rendered with (w = 0 otherwise)
+    std::vector<uint64_t> m_light_shadow_frame; // frame each light's layers were last refreshed
+    uint64_t m_shadow_frame = 0;
+    std::vector<uint64_t> m_shadow_stamps; // inputs each layer was last rendered with (0 = never)
+    glm::vec4 m_cascade_splits = glm::vec4(0.f); // view-space far distance of each cascade
+    uint64_t m_geometry_revision = 0;      // bumped whenever the arena's draw list changes
     int m_shadow_size = 1024;
-    GLuint m_shadow_shader;
-    int numLights;  // number of total lights (max 8)
+    GLuint m_shadow_shader = 0;           // spot and directional layers: depth from the rasterizer
+    ShadowUniforms m_shadow_uniforms;
+    GLuint m_point_shadow_shader = 0;     // POINT_SHADOWS: point faces write linear distance
+    ShadowUniforms m_point_shadow_uniforms;
+    int numLights;  // lights with shadow maps (the first 8)
     void initializeShadowDepths();
     void initializeShadowFBO();
     void computeLightMVPs();
+    void computeCascadeMVPs(const SceneLightData &light, int firstLayer);
+    std::vector<int> scheduleShadowUpdates(std::vector<uint64_t> &stamps);
     void paintShadows();
+    void drawShadowCasters(const std::vector<int> &layers);
+
+    // Prefiltered EVSM: moments of each layer, blurred and mipmapped
+    GLuint m_shadow_moments = 0;          // GL_TEXTURE_2D_ARRAY, RGBA16F, mipmapped
+    GLuint m_moments_scratch = 0;         // GL_TEXTURE_2D, horizontal blur target
+    GLuint m_fbo_moments = 0;
+    GLuint m_shadow_depth_sampler = 0;    // raw depth reads (overrides compare mode)
+    GLuint m_moments_shader = 0;
+    MomentsUniforms m_moments_uniforms;
+    std::vector<uint64_t> m_moment_stamps; // m_shadow_stamps each layer was filtered from
+    void initializeShadowMoments();
+    void filterShadowMoments();
 
     // ==== Internal helpers ====
     void rebuildScene();
-    void buildShape(GLShape &shape,
-                    const std::vector<float> &data,
-                    const glm::mat4 &model);
-    void shader(const RenderShapeData& shape, const std::vector<SceneLightData>& lights);
+    void uploadMeshes();
+    void uploadMaterials();
+    void initializeUniformBlocks();
+    void uploadCamera(const glm::mat4 &view, const glm::mat4 &proj);
     void uploadLights();
+
+    // ==== Clustered lighting ====
+    GLuint m_light_buffer = 0;            // LightRecord per light (TBO)
+    GLuint m_light_texture = 0;
+    GLuint m_cluster_buffer = 0;          // RG32UI (first index, count) per cluster
+    GLuint m_cluster_texture = 0;
+    GLuint m_cluster_index_buffer = 0;    // R32UI light indices
+    GLuint m_cluster_index_texture = 0;
+    std::vector<AABB> m_cluster_bounds;   // view-space bounds of each cluster
+    glm::mat4 m_cluster_view = glm::mat4(0.f);   // inputs of the current assignment
+    glm::mat4 m_cluster_proj = glm::mat4(0.f);
+    bool m_clusters_dirty = true;         // set when the light table changes
+    void initializeClusters();
+    void assignLightClusters(const glm::mat4 &view, const glm::mat4 &proj);
+
+    // Per-object light lists: lights whose sphere/cone reaches each
+    // instance's world bounds (default.frag walks the shorter of this
+    // and its cluster's list)
+    GLuint m_object_range_buffer = 0;     // RG32UI (first index, count) per instance
+    GLuint m_object_range_texture = 0;
+    GLuint m_object_light_buffer = 0;     // R32UI light indices
+    GLuint m_object_light_texture = 0;
+    bool m_object_lights_dirty = true;    // set when the lights or the instances change
+    void assignObjectLights();
+
+    // ==== Forward / deferred shading ====
+    uint32_t frameFeatures() const;               // everything but FEATURE_TEXTURE
+    const PhongProgram &phongProgram(uint32_t features);
+    const PhongProgram &gbufferProgram(uint32_t features);
+    const DeferredProgram &deferredProgram(uint32_t features);
+    bool programsReady(uint32_t features);        // requests without blocking, polls
+    void loadPassPrograms();                      // blit, shadow-map and moments programs
+    void prepareFrame();                          // camera, light table, clusters
+    void bindLighting(const PhongUniforms &u, uint32_t features);   // cluster tables + shadows
+    void bindSurface(const PhongUniforms &u);     // bump map + material table
+    void drawBatches(bool gbuffer, uint32_t features);  // one multi-draw per texture batch
     void paintGeometry();
 
+    // G-buffer at m_fbo_width x m_fbo_height: RGBA8 albedo, RGBA16UI
+    // (octahedral normal, material slot) and depth; lit by one full-screen
+    // pass into whatever framebuffer was bound
+    GLuint m_gbuffer_fbo = 0;
+    GLuint m_gbuffer_albedo = 0;
+    GLuint m_gbuffer_normal = 0;
+    GLuint m_gbuffer_depth = 0;
+    void makeGBuffer();
+    void deleteGBuffer();
+    void paintDeferred();
+
     GLuint m_height_map;
     QImage m_image;
     void loadHeightMap2D(const std::string &filename);
-    std::vector<float> loadOBJ(const std::string& filename);
 };
 
@@ -15,6 +15,11 @@ struct Settings {
     bool extraCredit2 = false;
     bool extraCredit3 = false;
     bool extraCredit4 = false;
+    int shadowTaps = 4;   // shadow lookup kernel: 1 (single compare), 4, 8 or 16 Poisson taps
+    bool varianceShadows = false;   // prefiltered EVSM lookup instead of PCF
+    int shadowBudget = 12;          // shadow layers refreshed per frame (0 = no limit)
+    bool deferredShading = false;   // G-buffer + full-screen lighting pass instead of forward
+    bool bumpMapping = false;       // perturb normals with the pattern height map
 };
 
 
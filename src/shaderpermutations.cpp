@@ -0,0 +1,160 @@
+#include "realtime.h"
+#include "settings.h"
+
+#include <algorithm>
+#include <string>
+
+// ================================================================
+// Shader permutations. default.frag, gbuffer.frag and deferred.frag
+// (through lighting.glsl) compile their optional paths under
+// #ifdefs; each feature mask maps to one program, compiled the
+// first time a frame asks for it and cached for the session.
+// Per-frame features come from the settings, the shadow state and
+// the scene's light types; FEATURE_TEXTURE is picked per batch.
+//
+// Programs are requested up front and compile in the background;
+// programsReady polls a frame's set so startup never waits on the
+// driver, while the getters below block if something is still in
+// flight.
+// ================================================================
+
+static const char *DEFAULT_VERT  = ":/resources/shaders/default.vert";
+static const char *DEFAULT_FRAG  = ":/resources/shaders/default.frag";
+static const char *GBUFFER_FRAG  = ":/resources/shaders/gbuffer.frag";
+static const char *DEFERRED_FRAG = ":/resources/shaders/deferred.frag";
+static const char *TEXTURE_VERT  = ":/resources/shaders/texture.vert";
+static const char *TEXTURE_FRAG  = ":/resources/shaders/texture.frag";
+static const char *SHADOW_VERT   = ":/resources/shaders/shadowmap.vert";
+static const char *SHADOW_GEOM   = ":/resources/shaders/shadowmap.geom";
+static const char *SHADOW_FRAG   = ":/resources/shaders/shadowmap.frag";
+static const char *MOMENTS_FRAG  = ":/resources/shaders/shadowmoments.frag";
+
+static ShaderDefines featureDefines(uint32_t features) {
+    ShaderDefines defines;
+    if (features & FEATURE_TEXTURE)     defines.push_back("USE_TEXTURE");
+    if (features & FEATURE_BUMP)        defines.push_back("USE_BUMP");
+    if (features & FEATURE_EVSM)        defines.push_back("EVSM");
+    if (features & FEATURE_POINT)       defines.push_back("HAS_POINT");
+    if (features & FEATURE_DIRECTIONAL) defines.push_back("HAS_DIRECTIONAL");
+    if (features & FEATURE_SPOT)        defines.push_back("HAS_SPOT");
+    if (features & FEATURE_SHADOWS) {
+        defines.push_back("SHADOWS");
+        defines.push_back("SHADOWED_LIGHTS " + std::to_string((features >> FEATURE_SHADOWED_SHIFT) & 0xF));
+    }
+    return defines;
+}
+
+uint32_t Realtime::frameFeatures() const {
+    uint32_t features = 0;
+
+    if (settings.bumpMapping && m_height_map != 0) features |= FEATURE_BUMP;
+
+    // Same conditions paintShadows/filterShadowMoments run under
+    int shadowed = std::min<int>(static_cast<int>(m_light_shadow_layers.size()), 8);
+    if (settings.extraCredit4 && !m_rendered_MVPs.empty() && shadowed > 0) {
+        features |= FEATURE_SHADOWS | (uint32_t(shadowed) << FEATURE_SHADOWED_SHIFT);
+        if (settings.varianceShadows && m_shadow_moments != 0) features |= FEATURE_EVSM;
+    }
+
+    for (const SceneLightData &light : m_renderData.lights) {
+        switch (light.type) {
+        case LightType::LIGHT_POINT:       features |= FEATURE_POINT;       break;
+        case LightType::LIGHT_DIRECTIONAL: features |= FEATURE_DIRECTIONAL; break;
+        case LightType::LIGHT_SPOT:        features |= FEATURE_SPOT;        break;
+        }
+    }
+
+    return features;
+}
+
+const PhongProgram &Realtime::phongProgram(uint32_t features) {
+    auto it = m_phong_programs.find(features);
+    if (it != m_phong_programs.end()) return it->second;
+
+    const ProgramCache::Program &compiled = m_program_cache.get(DEFAULT_VERT, DEFAULT_FRAG, featureDefines(features));
+
+    PhongProgram &variant = m_phong_programs[features];
+    variant.program = compiled.id;
+    variant.uniforms.load(compiled.reflection);
+    return variant;
+}
+
+const PhongProgram &Realtime::gbufferProgram(uint32_t features) {
+    features &= SURFACE_FEATURES;
+    auto it = m_gbuffer_programs.find(features);
+    if (it != m_gbuffer_programs.end()) return it->second;
+
+    const ProgramCache::Program &compiled = m_program_cache.get(DEFAULT_VERT, GBUFFER_FRAG, featureDefines(features));
+
+    PhongProgram &variant = m_gbuffer_programs[features];
+    variant.program = compiled.id;
+    variant.uniforms.load(compiled.reflection);
+    return variant;
+}
+
+const DeferredProgram &Realtime::deferredProgram(uint32_t features) {
+    features &= ~SURFACE_FEATURES;
+    auto it = m_deferred_programs.find(features);
+    if (it != m_deferred_programs.end()) return it->second;
+
+    const ProgramCache::Program &compiled = m_program_cache.get(TEXTURE_VERT, DEFERRED_FRAG, featureDefines(features));
+
+    DeferredProgram &variant = m_deferred_programs[features];
+    variant.program = compiled.id;
+    variant.uniforms.load(compiled.reflection);
+    return variant;
+}
+
+bool Realtime::programsReady(uint32_t features) {
+    // Every pass program is requested, even ones this frame skips, so
+    // they are linked by the time a setting turns them on
+    bool ready = m_program_cache.ready(TEXTURE_VERT, TEXTURE_FRAG);
+    bool shadowReady = m_program_cache.ready(SHADOW_VERT, SHADOW_FRAG, {}, SHADOW_GEOM);
+    shadowReady &= m_program_cache.ready(SHADOW_VERT, SHADOW_FRAG, { "POINT_SHADOWS" }, SHADOW_GEOM);
+    bool momentsReady = m_program_cache.ready(TEXTURE_VERT, MOMENTS_FRAG);
+    if (settings.extraCredit4) ready &= shadowReady && (momentsReady || !settings.varianceShadows);
+
+    // Both texture variants: batches pick FEATURE_TEXTURE themselves
+    for (uint32_t texture : { 0u, uint32_t(FEATURE_TEXTURE) }) {
+        uint32_t f = features | texture;
+        if (settings.deferredShading) {
+            ready &= m_program_cache.ready(DEFAULT_VERT, GBUFFER_FRAG, featureDefines(f & SURFACE_FEATURES));
+        } else {
+            ready &= m_program_cache.ready(DEFAULT_VERT, DEFAULT_FRAG, featureDefines(f));
+        }
+    }
+    if (settings.deferredShading) {
+        ready &= m_program_cache.ready(TEXTURE_VERT, DEFERRED_FRAG, featureDefines(features & ~SURFACE_FEATURES));
+    }
+
+    return ready;
+}
+
+void Realtime::loadPassPrograms() {
+    if (m_texture_shader == 0) {
+        const ProgramCache::Program &program = m_program_cache.get(TEXTURE_VERT, TEXTURE_FRAG);
+        m_texture_shader = program.id;
+        m_texture_uniforms.load(program.reflection);
+    }
+
+    // Shadow programs only once shadows are on, so they never hold up a frame
+    // that does not use them
+    if (!settings.extraCredit4) return;
+
+    if (m_shadow_shader == 0) {
+        const ProgramCache::Program &program = m_program_cache.get(SHADOW_VERT, SHADOW_FRAG, {}, SHADOW_GEOM);
+        m_shadow_shader = program.id;
+        m_shadow_uniforms.load(program.reflection);
+    }
+    if (m_point_shadow_shader == 0) {
+        const ProgramCache::Program &program =
+            m_program_cache.get(SHADOW_VERT, SHADOW_FRAG, { "POINT_SHADOWS" }, SHADOW_GEOM);
+        m_point_shadow_shader = program.id;
+        m_point_shadow_uniforms.load(program.reflection);
+    }
+    if (m_moments_shader == 0 && settings.varianceShadows) {
+        const ProgramCache::Program &program = m_program_cache.get(TEXTURE_VERT, MOMENTS_FRAG);
+        m_moments_shader = program.id;
+        m_moments_uniforms.load(program.reflection);
+    }
+}
@@ -3,6 +3,34 @@
 #include "glm/ext/matrix_clip_space.hpp"
 #include "glm/ext/matrix_transform.hpp"
 
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+// Gaussian taps on each side of the EVSM prefilter, per axis
+static constexpr int EVSM_BLUR_RADIUS = 3;
+
+void ShadowUniforms::load(const ShaderReflection &r) {
+    lightMVPs      = r.uniform("lightMVPs");
+    layers         = r.uniform("layers");
+    layerCount     = r.uniform("layerCount");
+    layerViewports = r.uniform("layerViewports");
+    layerSlices    = r.uniform("layerSlices");
+    layerPoints    = r.uniform("layerPoints");
+}
+
+void MomentsUniforms::load(const ShaderReflection &r) {
+    depthLayers = r.uniform("depthLayers");
+    blurSource  = r.uniform("blurSource");
+    fromDepth   = r.uniform("fromDepth");
+    layer       = r.uniform("layer");
+    origin      = r.uniform("origin");
+    region      = r.uniform("region");
+    blurRadius  = r.uniform("blurRadius");
+    exponents   = r.uniform("exponents");
+}
+
 void Realtime::initializeShadowFBO() {
     // create FBO
     glGenFramebuffers(1, &m_fbo_shadow);
@@ -12,40 +40,148 @@ void Realtime::initializeShadowFBO() {
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
 
+    // EVSM prefilter target; its color attachment changes every pass
+    glGenFramebuffers(1, &m_fbo_moments);
+
     glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+
+    // The prefilter reads raw depth from the array, whose own state
+    // enables hardware compare
+    glGenSamplers(1, &m_shadow_depth_sampler);
+    glSamplerParameteri(m_shadow_depth_sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glSamplerParameteri(m_shadow_depth_sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glSamplerParameteri(m_shadow_depth_sampler, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+}
+
+// Texel corner of a cascade quadrant: 0 lower-left, 1 lower-right, 2 upper-left
+static glm::ivec2 shadowQuadrantOrigin(int quadrant, int shadowSize) {
+    int half = shadowSize >> CASCADE_TIER;
+    return glm::ivec2((quadrant & 1) * half, (quadrant >> 1) * half);
+}
+
+glm::ivec2 Realtime::shadowLayerOrigin(int layer) const {
+    return shadowQuadrantOrigin(m_shadow_layer_quadrants[layer], m_shadow_size);
+}
+
+// Attenuated contributions below this are dropped (one 8-bit step)
+static constexpr float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// Depth range of spot and point shadows when the light's range is larger
+static constexpr float MAX_SHADOW_RANGE = 50.0f;
+
+// Smallest range given to a light with finite falloff
+static constexpr float MIN_LIGHT_RANGE = 0.5f;
+
+// ================================================================
+// Distance at which a light's attenuated contribution drops below
+// LIGHT_CUTOFF, from default.frag's 1 / (c + l d + q d^2). Returns 0
+// (unbounded) only for lights that never fall off (directional,
+// constant); a light that is below the cutoff everywhere gets
+// MIN_LIGHT_RANGE, like any other short range.
+// ================================================================
+static float lightRange(const SceneLightData &light) {
+    if (light.type == LightType::LIGHT_DIRECTIONAL) return 0.0f;
+
+    const float cutoff = std::max({ light.color.r, light.color.g, light.color.b, 1e-3f }) / LIGHT_CUTOFF;
+
+    float c = light.function.x, l = light.function.y, q = light.function.z;
+    float range = 0.0f;
+    if (q > 0.0f) {
+        // No real root: the denominator exceeds cutoff at every distance
+        float disc = l * l - 4.0f * q * (c - cutoff);
+        if (disc < 0.0f) return MIN_LIGHT_RANGE;
+        range = (-l + std::sqrt(disc)) / (2.0f * q);
+    } else if (l > 0.0f) {
+        range = (cutoff - c) / l;
+    } else {
+        return 0.0f;
+    }
+    return std::max(range, MIN_LIGHT_RANGE);
 }
 
 void Realtime::initializeShadowDepths() {
-    // delete existing shadow textures
-    if (!m_shadow_maps.empty()) {
-        glDeleteTextures(m_shadow_maps.size(), m_shadow_maps.data());
-        m_shadow_maps.clear();
+    // delete the existing shadow array
+    if (m_shadow_array) {
+        glDeleteTextures(1, &m_shadow_array);
+        m_shadow_array = 0;
     }
 
+    // Moments follow the array's layout; rebuilt on the next EVSM frame
+    if (m_shadow_moments)  glDeleteTextures(1, &m_shadow_moments);
+    if (m_moments_scratch) glDeleteTextures(1, &m_moments_scratch);
+    m_shadow_moments = m_moments_scratch = 0;
+    m_moment_stamps.clear();
+
     // Keep track of the number of lights
     numLights = m_renderData.lights.size();
     numLights = (int)std::min((float)numLights, 8.f);
 
-    m_shadow_maps.resize(numLights);
+    // Lay out the array: cascades for directional lights, one layer per
+    // spot light, six faces per point light. Lights past the budget go
+    // unshadowed.
+    m_light_shadow_layers.assign(numLights, -1);
+    m_light_shadow_far.assign(numLights, 0.0f);
 
-    // depth textures for each directional/spot light
-    glGenTextures(numLights, m_shadow_maps.data());
+    // Ranges of every light: shadow frusta here, clusters in lightclusters.cpp
+    m_light_ranges.clear();
+    for (const SceneLightData &light : m_renderData.lights) {
+        m_light_ranges.push_back(lightRange(light));
+    }
+    m_shadow_layer_lights.clear();
+    m_shadow_layer_tiers.clear();
+    m_shadow_layer_slices.clear();
+    m_shadow_layer_quadrants.clear();
+    int sliceCount = 0;
     for (int i = 0; i < numLights; i++) {
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, m_shadow_maps[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, m_shadow_size, m_shadow_size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-        // add texture
-        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_shadow);
-        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadow_maps[i], 0);
-        glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+        const SceneLightData &light = m_renderData.lights[i];
+        int layers = light.type == LightType::LIGHT_DIRECTIONAL ? SHADOW_CASCADES
+                   : light.type == LightType::LIGHT_SPOT        ? 1 : 6;
+        if ((int)m_shadow_layer_lights.size() + layers > MAX_SHADOW_LAYERS) continue;
+
+        // Spot frusta end at the light's range; point faces store
+        // distance over it
+        if (light.type != LightType::LIGHT_DIRECTIONAL) {
+            float range = m_light_ranges[i];
+            m_light_shadow_far[i] = range > 0.0f ? std::min(range, MAX_SHADOW_RANGE) : MAX_SHADOW_RANGE;
+        }
+
+        // Tiers are chosen by scheduleShadowUpdates() before the first render
+        m_light_shadow_layers[i] = static_cast<int>(m_shadow_layer_lights.size());
+        m_shadow_layer_lights.insert(m_shadow_layer_lights.end(), layers, i);
+
+        // Cascades: one slice, a fixed-tier quadrant each; other layers a slice each
+        bool cascades = light.type == LightType::LIGHT_DIRECTIONAL;
+        m_shadow_layer_tiers.insert(m_shadow_layer_tiers.end(), layers, cascades ? CASCADE_TIER : 0);
+        for (int k = 0; k < layers; k++) {
+            m_shadow_layer_slices.push_back(cascades ? sliceCount : sliceCount + k);
+            m_shadow_layer_quadrants.push_back(cascades ? k : 0);
+        }
+        sliceCount += cascades ? 1 : layers;
     }
+
+    int layerCount = static_cast<int>(m_shadow_layer_lights.size());
+    m_light_MVPs.assign(layerCount, glm::mat4(1.0f));
+    m_rendered_MVPs.assign(layerCount, glm::mat4(1.0f));
+    m_rendered_points.assign(layerCount, glm::vec4(0.0f));
+    m_shadow_stamps.assign(layerCount, 0);   // fresh layers hold nothing yet
+    m_light_shadow_frame.assign(numLights, 0);
+    if (layerCount == 0) return;
+
+    glGenTextures(1, &m_shadow_array);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_array);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT16, m_shadow_size, m_shadow_size, sliceCount, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    // sampler2DArrayShadow: each lookup returns a bilinear 2x2 compare
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
     // unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 }
 
 // ================================================================
@@ -77,99 +213,313 @@ void Realtime::computeLightMVPs() {
     // in case the scene changed after initializeShadowDepths().
     numLights = std::min<int>((int)m_renderData.lights.size(), 8);
 
-    if (numLights == 0) {
-        m_light_MVPs.clear();
+    if (numLights == 0 || m_shadow_layer_lights.empty()) {
         return;
     }
 
-    m_light_MVPs.assign(numLights, glm::mat4(1.0f));
+    // Cascade splits: a blend of logarithmic and uniform spacing over the
+    // camera's depth range, so near cascades stay small without starving
+    // the far ones
+    const float cameraNear = std::max(settings.nearPlane, 0.01f);
+    const float cameraFar  = std::max(settings.farPlane, cameraNear + 0.01f);
+    const float lambda = 0.75f;
+
+    m_cascade_splits = glm::vec4(cameraFar);
+    for (int c = 0; c < SHADOW_CASCADES; c++) {
+        float t = float(c + 1) / SHADOW_CASCADES;
+        float uniformSplit = cameraNear + (cameraFar - cameraNear) * t;
+        float logSplit     = cameraNear * std::pow(cameraFar / cameraNear, t);
+        m_cascade_splits[c] = glm::mix(uniformSplit, logSplit, lambda);
+    }
 
-    // Shadow near/far planes (separate from the camera's near/far)
+    // Shadow near plane for spot and point lights; the far plane is the
+    // light's range
     const float shadowNear = 0.1f;
-    const float shadowFar  = 50.0f;
-
-    // Rough "scene radius" for directional light coverage
-    const float sceneRadius = 15.0f;
-    const glm::vec3 sceneCenter(0.0f);
 
     std::vector<SceneLightData> &lights = m_renderData.lights;
 
-    for (int i = 0; i < numLights; i++) {
+    for (int i = 0; i < numLights && i < (int)m_light_shadow_layers.size(); i++) {
         const SceneLightData &light = lights[i];
+        int layer = m_light_shadow_layers[i];
+        if (layer < 0) continue;
 
-        glm::mat4 depthProjectionMatrix(1.0f);
-        glm::mat4 depthViewMatrix(1.0f);
-
-        switch (light.type) {
-        case LightType::LIGHT_DIRECTIONAL: {
-            // Directional light: direction in world space
-            glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+        if (light.type == LightType::LIGHT_DIRECTIONAL) {
+            computeCascadeMVPs(light, layer);
+            continue;
+        }
 
-            // Position the "shadow camera" back along the light direction
-            glm::vec3 eye = sceneCenter - dir * sceneRadius * 2.0f;
+        if (light.type == LightType::LIGHT_POINT) {
+            // Six 90-degree faces, +x -x +y -y +z -z, out to the light's range
+            static const glm::vec3 faceDirs[6] = {
+                { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }
+            };
+            static const glm::vec3 faceUps[6] = {
+                { 0, -1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 }, { 0, -1, 0 }, { 0, -1, 0 }
+            };
 
-            glm::vec3 up(0.0f, 1.0f, 0.0f);
-            if (fabs(glm::dot(dir, up)) > 0.99f) {
-                up = glm::vec3(0.0f, 0.0f, 1.0f);
+            glm::vec3 pos = glm::vec3(light.pos);
+            float far = m_light_shadow_far[i];
+            glm::mat4 depthProjectionMatrix = glm::perspective(glm::radians(90.0f), 1.0f,
+                                                               std::min(shadowNear, 0.1f * far), far);
+            for (int face = 0; face < 6; face++) {
+                m_light_MVPs[layer + face] = depthProjectionMatrix
+                    * glm::lookAt(pos, pos + faceDirs[face], faceUps[face]);
             }
+            continue;
+        }
+
+        // Spot light
+        glm::vec3 pos = glm::vec3(light.pos);
+        glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+
+        // Outer cone ~ angle + penumbra; full FOV = 2 * outer
+        float outer = light.angle + light.penumbra;
+        float fovy  = 2.0f * outer;
+        // clamp to something sane
+        fovy = glm::clamp(fovy, glm::radians(5.0f), glm::radians(170.0f));
+
+        float far = m_light_shadow_far[i];
+        glm::mat4 depthProjectionMatrix = glm::perspective(
+            fovy,           // vertical FOV
+            1.0f,           // square shadow map
+            std::min(shadowNear, 0.1f * far),
+            far
+            );
+
+        glm::vec3 up(0.0f, 1.0f, 0.0f);
+        if (fabs(glm::dot(dir, up)) > 0.99f) {
+            up = glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+
+        glm::mat4 depthViewMatrix = glm::lookAt(pos, pos + dir, up);
 
-            depthViewMatrix = glm::lookAt(eye, sceneCenter, up);
+        // IMPORTANT: this is P * V ONLY (no model).
+        m_light_MVPs[layer] = depthProjectionMatrix * depthViewMatrix;
+    }
+}
+
+// ================================================================
+// Cascades for one directional light: each slice of the camera
+// frustum gets an ortho projection around its bounding sphere. The
+// sphere's radius does not change as the camera turns, and its
+// center is snapped to whole shadow texels, so the maps do not
+// shimmer (or re-render) while the camera holds still.
+// ================================================================
+void Realtime::computeCascadeMVPs(const SceneLightData &light, int firstLayer) {
+    const float aspect = float(width()) / float(std::max(height(), 1));
+    const glm::mat4 cameraToWorld = glm::inverse(m_camera.getViewMatrix());
+
+    glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
+    glm::vec3 up(0.0f, 1.0f, 0.0f);
+    if (fabs(glm::dot(dir, up)) > 0.99f) {
+        up = glm::vec3(0.0f, 0.0f, 1.0f);
+    }
 
-            depthProjectionMatrix = glm::ortho(
-                -sceneRadius, sceneRadius,
-                -sceneRadius, sceneRadius,
-                shadowNear, shadowFar
-                );
-            break;
+    // Rotation only; each cascade's ortho box supplies the offset.
+    // The light looks down -z, so larger z is closer to the light.
+    const glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), dir, up);
+
+    // Casters anywhere in the scene may shade a slice
+    AABB sceneLight = m_scene_bounds.transformed(lightView);
+
+    float sliceNear = std::max(settings.nearPlane, 0.01f);
+    for (int c = 0; c < SHADOW_CASCADES; c++) {
+        float sliceFar = m_cascade_splits[c];
+        glm::mat4 sliceToWorld = cameraToWorld
+            * glm::inverse(m_camera.getProjectionMatrix(aspect, sliceNear, sliceFar));
+
+        glm::vec3 corners[8];
+        glm::vec3 center(0.0f);
+        for (int k = 0; k < 8; k++) {
+            glm::vec4 ndc((k & 1) ? 1.f : -1.f, (k & 2) ? 1.f : -1.f, (k & 4) ? 1.f : -1.f, 1.f);
+            glm::vec4 world = sliceToWorld * ndc;
+            corners[k] = glm::vec3(world) / world.w;
+            center += corners[k] / 8.0f;
         }
 
-        case LightType::LIGHT_SPOT: {
-            glm::vec3 pos = glm::vec3(light.pos);
-            glm::vec3 dir = glm::normalize(glm::vec3(light.dir));
-
-            // Outer cone ~ angle + penumbra; full FOV = 2 * outer
-            float outer = light.angle + light.penumbra;
-            float fovy  = 2.0f * outer;
-            // clamp to something sane
-            fovy = glm::clamp(fovy, glm::radians(5.0f), glm::radians(170.0f));
-
-            depthProjectionMatrix = glm::perspective(
-                fovy,           // vertical FOV
-                1.0f,           // square shadow map
-                shadowNear,
-                shadowFar
-                );
-
-            glm::vec3 up(0.0f, 1.0f, 0.0f);
-            if (fabs(glm::dot(dir, up)) > 0.99f) {
-                up = glm::vec3(0.0f, 0.0f, 1.0f);
+        float radius = 0.0f;
+        for (const glm::vec3 &corner : corners) {
+            radius = std::max(radius, glm::length(corner - center));
+        }
+        radius = std::ceil(radius * 16.0f) / 16.0f;
+
+        glm::vec3 centerLight = glm::vec3(lightView * glm::vec4(center, 1.0f));
+        float texel = 2.0f * radius / float(m_shadow_size >> CASCADE_TIER);
+        centerLight.x = std::floor(centerLight.x / texel) * texel;
+        centerLight.y = std::floor(centerLight.y / texel) * texel;
+
+        float zFar  = centerLight.z - radius;
+        float zNear = centerLight.z + radius;
+        if (!sceneLight.empty()) zNear = std::max(zNear, sceneLight.max.z);
+
+        glm::mat4 depthProjectionMatrix = glm::ortho(
+            centerLight.x - radius, centerLight.x + radius,
+            centerLight.y - radius, centerLight.y + radius,
+            -zNear, -zFar
+            );
+
+        m_light_MVPs[firstLayer + c] = depthProjectionMatrix * lightView;
+        sliceNear = sliceFar;
+    }
+}
+
+
+
+// ================================================================
+// Shadow map version stamp: FNV-1a over everything the depth pass
+// reads for one light. Color and attenuation set a spot or point light's
+// range, and with it the far plane and the stored distance scale.
+// ================================================================
+static uint64_t shadowStamp(const SceneLightData &light, const glm::mat4 &mvp, int tier,
+                            uint64_t geometryRevision) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&hash](const void *data, size_t size) {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+    };
+
+    int type = static_cast<int>(light.type);
+    mix(&type, sizeof(type));
+    mix(&light.pos, sizeof(light.pos));
+    mix(&light.dir, sizeof(light.dir));
+    mix(&light.angle, sizeof(light.angle));
+    mix(&light.penumbra, sizeof(light.penumbra));
+    mix(&light.color, sizeof(light.color));
+    mix(&light.function, sizeof(light.function));
+    mix(&mvp, sizeof(mvp));
+    mix(&tier, sizeof(tier));
+    mix(&geometryRevision, sizeof(geometryRevision));
+
+    return hash == 0 ? 1 : hash;   // 0 is reserved for "never rendered"
+}
+
+// ================================================================
+// Shadow update scheduler. Each light gets an influence, roughly the
+// share of the view its range sphere can cover (1 for directional
+// lights and lights around the camera). Influence picks the
+// resolution tier of spot and point lights and how many frames a
+// changed map may wait. Lights with changed layers are refreshed in
+// priority order, whole lights at a time, until
+// settings.shadowBudget layers are spent; directional cascades must
+// match this frame's splits and are never deferred.
+//
+// Fills stamps for every layer with the inputs it would be rendered
+// with now and returns the layers to render this frame.
+// ================================================================
+std::vector<int> Realtime::scheduleShadowUpdates(std::vector<uint64_t> &stamps) {
+    m_shadow_frame++;
+
+    const glm::vec3 eye = glm::vec3(m_camera.pos);
+    const float tanHalfFov = std::tan(0.5f * m_camera.getHeightAngle());
+
+    struct Candidate {
+        int light;
+        int tier;
+        bool required;       // directional, or holds nothing yet
+        float priority;      // influence x frames waited
+        std::vector<int> layers;
+    };
+    std::vector<Candidate> candidates;
+
+    for (int i = 0; i < numLights && i < (int)m_light_shadow_layers.size(); i++) {
+        int first = m_light_shadow_layers[i];
+        if (first < 0) continue;
+
+        const SceneLightData &light = m_renderData.lights[i];
+        int layerCount = light.type == LightType::LIGHT_DIRECTIONAL ? SHADOW_CASCADES
+                       : light.type == LightType::LIGHT_SPOT        ? 1 : 6;
+
+        // Angular radius of the range sphere against the camera's half FOV
+        float influence = 1.0f;
+        int tier = light.type == LightType::LIGHT_DIRECTIONAL ? CASCADE_TIER : 0;
+        if (light.type != LightType::LIGHT_DIRECTIONAL) {
+            float range = m_light_ranges[i];
+            float dist = glm::length(glm::vec3(light.pos) - eye);
+            if (range > 0.0f && dist > range) {
+                float sinAngle = range / dist;
+                float tanAngle = sinAngle / std::sqrt(1.0f - sinAngle * sinAngle);
+                influence = std::min(1.0f, tanAngle / std::max(tanHalfFov, 1e-3f));
             }
 
-            depthViewMatrix = glm::lookAt(pos, pos + dir, up);
-            break;
+            // Texels across a layer: the light's share of the view, and
+            // for point lights at most 64 per unit of range
+            float wanted = influence * m_shadow_size;
+            if (light.type == LightType::LIGHT_POINT) wanted = std::min(wanted, m_light_shadow_far[i] * 64.0f);
+            while (tier + 1 < SHADOW_TIERS && (m_shadow_size >> (tier + 1)) >= wanted) tier++;
         }
 
-        default:
-            // We don't create shadow maps for point lights here
-            depthProjectionMatrix = glm::mat4(1.0f);
-            depthViewMatrix       = glm::mat4(1.0f);
-            break;
+        Candidate candidate{ i, tier, light.type == LightType::LIGHT_DIRECTIONAL, 0.0f, {} };
+        for (int layer = first; layer < first + layerCount; layer++) {
+            stamps[layer] = shadowStamp(light, m_light_MVPs[layer], tier, m_geometry_revision);
+            if (stamps[layer] == m_shadow_stamps[layer]) continue;
+            candidate.layers.push_back(layer);
+            candidate.required = candidate.required || m_shadow_stamps[layer] == 0;
         }
+        if (candidate.layers.empty()) continue;
 
-        // IMPORTANT: this is P * V ONLY (no model).
-        m_light_MVPs[i] = depthProjectionMatrix * depthViewMatrix;
+        // Minor lights may wait a few frames between refreshes
+        uint64_t waited = m_shadow_frame - m_light_shadow_frame[i];
+        uint64_t interval = influence >= 0.25f ? 1 : influence >= 0.0625f ? 2 : 4;
+        if (!candidate.required && waited < interval) continue;
+
+        candidate.priority = influence * float(waited);
+        candidates.push_back(std::move(candidate));
     }
-}
 
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const Candidate &a, const Candidate &b) {
+                         if (a.required != b.required) return a.required;
+                         return a.priority > b.priority;
+                     });
+
+    // The first other light always goes, so a budget smaller than one
+    // light's layers still makes progress
+    const size_t budget = settings.shadowBudget > 0 ? size_t(settings.shadowBudget) : SIZE_MAX;
+    bool progressed = false;
+
+    std::vector<int> dirty;
+    for (const Candidate &candidate : candidates) {
+        if (m_renderData.lights[candidate.light].type != LightType::LIGHT_DIRECTIONAL) {
+            if (progressed && dirty.size() + candidate.layers.size() > budget) {
+                continue;   // a smaller light further down may still fit
+            }
+            progressed = true;
+        }
 
+        // The tier is only committed once the layer is re-rendered at it
+        for (int layer : candidate.layers) m_shadow_layer_tiers[layer] = candidate.tier;
+        dirty.insert(dirty.end(), candidate.layers.begin(), candidate.layers.end());
+        m_light_shadow_frame[candidate.light] = m_shadow_frame;
+    }
+    return dirty;
+}
 
 void Realtime::paintShadows() {
     // No lights or no shadow maps → nothing to do
-    if (numLights == 0 || m_shadow_maps.empty() || m_renderData.shapes.empty()) {
+    if (numLights == 0 || !m_shadow_array || m_renderData.shapes.empty()) {
         return;
     }
 
-    glUseProgram(m_shadow_shader);
+    int nLayers = static_cast<int>(m_shadow_layer_lights.size());
+    if ((int)m_light_MVPs.size() < nLayers || (int)m_shadow_stamps.size() < nLayers) return;
+
+    // Only layers whose inputs changed, within this frame's budget
+    std::vector<uint64_t> stamps(m_shadow_stamps);
+    std::vector<int> dirty = scheduleShadowUpdates(stamps);
+    if (dirty.empty()) return;
+
+    // Deferred layers keep sampling with the matrix (and, for point faces,
+    // the light position and far distance) they were rendered with.
+    // Point faces write linear distance to the light instead of depth.
+    for (int layer : dirty) {
+        int li = m_shadow_layer_lights[layer];
+        const SceneLightData &light = m_renderData.lights[li];
+        m_rendered_MVPs[layer] = m_light_MVPs[layer];
+        m_rendered_points[layer] = light.type == LightType::LIGHT_POINT
+            ? glm::vec4(glm::vec3(light.pos), m_light_shadow_far[li]) : glm::vec4(0.0f);
+    }
 
     // Save current viewport/FBO
     GLint oldViewport[4];
@@ -179,51 +529,230 @@ void Realtime::paintShadows() {
     glViewport(0, 0, m_shadow_size, m_shadow_size);
     glEnable(GL_DEPTH_TEST);
 
-    int nLights = std::min<int>(numLights, static_cast<int>(m_renderData.lights.size()));
+    // A layered clear would wipe the cached layers too, and a cascade
+    // shares its slice with the others, so clear each layer's region alone
+    glEnable(GL_SCISSOR_TEST);
+    for (int layer : dirty) {
+        glm::ivec2 origin = shadowLayerOrigin(layer);
+        int region = m_shadow_size >> m_shadow_layer_tiers[layer];
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadow_array, 0, m_shadow_layer_slices[layer]);
+        glScissor(origin.x, origin.y, region, region);
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    glDisable(GL_SCISSOR_TEST);
 
-    for (int li = 0; li < nLights; li++) {
-        // Attach depth texture for this light
-        glFramebufferTexture2D(GL_FRAMEBUFFER,
-                               GL_DEPTH_ATTACHMENT,
-                               GL_TEXTURE_2D,
-                               m_shadow_maps[li],
-                               0);
+    // Attach every layer; shadowmap.geom routes each triangle to the dirty ones
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, m_shadow_array, 0);
 
-        glClear(GL_DEPTH_BUFFER_BIT);
+    // One viewport per resolution tier, all anchored at the layer's corner,
+    // then one per further cascade quadrant
+    for (int tier = 0; tier < SHADOW_TIERS; tier++) {
+        float size = float(m_shadow_size >> tier);
+        glViewportIndexedf(tier, 0.0f, 0.0f, size, size);
+    }
+    for (int quadrant = 1; quadrant < SHADOW_CASCADES; quadrant++) {
+        glm::vec2 origin = glm::vec2(shadowQuadrantOrigin(quadrant, m_shadow_size));
+        float size = float(m_shadow_size >> CASCADE_TIER);
+        glViewportIndexedf(SHADOW_TIERS + quadrant - 1, origin.x, origin.y, size, size);
+    }
+    std::vector<GLint> viewports(nLayers);
+    for (int layer = 0; layer < nLayers; layer++) {
+        int quadrant = m_shadow_layer_quadrants[layer];
+        viewports[layer] = quadrant == 0 ? m_shadow_layer_tiers[layer] : SHADOW_TIERS + quadrant - 1;
+    }
+
+    // Writing gl_FragDepth turns off early depth tests, so only point
+    // faces use the variant that does; the rest leave depth to the rasterizer
+    std::vector<int> groups[2];
+    for (int layer : dirty) {
+        bool point = m_renderData.lights[m_shadow_layer_lights[layer]].type == LightType::LIGHT_POINT;
+        groups[point].push_back(layer);
+    }
+
+    for (int point = 0; point < 2; point++) {
+        const std::vector<int> &layers = groups[point];
+        if (layers.empty()) continue;
+
+        const ShadowUniforms &u = point ? m_point_shadow_uniforms : m_shadow_uniforms;
+        glUseProgram(point ? m_point_shadow_shader : m_shadow_shader);
+        glUniformMatrix4fv(u.lightMVPs, nLayers, GL_FALSE, &m_rendered_MVPs[0][0][0]);
+        glUniform1iv(u.layerViewports, nLayers, viewports.data());
+        glUniform1iv(u.layerSlices, nLayers, m_shadow_layer_slices.data());
+        glUniform4fv(u.layerPoints, nLayers, &m_rendered_points[0][0]);
+        glUniform1iv(u.layers, static_cast<GLsizei>(layers.size()), layers.data());
+        glUniform1i(u.layerCount, static_cast<GLint>(layers.size()));
 
-        // Upload the light's MVP (world → light clip)
-        GLint locLightMVP = glGetUniformLocation(m_shadow_shader, "lightMVP");
-        glUniformMatrix4fv(locLightMVP, 1, GL_FALSE, &m_light_MVPs[li][0][0]);
-
-        // ==== Draw the SAME analytic primitives as paintGeometry() ====
-        size_t objIdx = 0;
-        for (const RenderShapeData &shape : m_renderData.shapes) {
-            PrimitiveType t = shape.primitive.type;
-            bool isAnalytic =
-                (t == PrimitiveType::PRIMITIVE_CUBE   ||
-                 t == PrimitiveType::PRIMITIVE_CONE   ||
-                 t == PrimitiveType::PRIMITIVE_SPHERE ||
-                 t == PrimitiveType::PRIMITIVE_CYLINDER);
-
-            if (!isAnalytic) {
-                continue; // meshes handled elsewhere, if you add them
+        drawShadowCasters(layers);
+    }
+
+    for (int layer : dirty) {
+        m_shadow_stamps[layer] = stamps[layer];
+    }
+
+    // Restore state
+    glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
+    glViewport(oldViewport[0], oldViewport[1],
+               oldViewport[2], oldViewport[3]);
+    glUseProgram(0);
+}
+
+// Culls every instance against the given layers and draws the survivors
+// once with the bound shadow program
+void Realtime::drawShadowCasters(const std::vector<int> &layers) {
+    // ==== Cull every instance against the layers' frusta ====
+    // Each surviving instance carries a mask of the layers it may cover;
+    // shadowmap.geom skips the rest, and culled instances are not drawn.
+    std::vector<DepthInstance> casters;
+    std::vector<DrawElementsIndirectCommand> commands;
+    casters.reserve(m_instance_models.size());
+    for (const GLShape &obj : m_objects) {
+        GLuint baseInstance = static_cast<GLuint>(casters.size());
+        for (int k = obj.baseInstance; k < obj.baseInstance + obj.instances; k++) {
+            GLuint mask = 0;
+            for (int layer : layers) {
+                // Outside the light's range sphere, then outside the layer's frustum
+                int li = m_shadow_layer_lights[layer];
+                float range = m_light_ranges[li];
+                if (range > 0.0f && !m_instance_bounds[k].intersects(glm::vec3(m_renderData.lights[li].pos), range)) {
+                    continue;
+                }
+                if (m_instance_bounds[k].intersects(m_light_MVPs[layer])) mask |= 1u << layer;
             }
+            if (mask) casters.push_back({ m_instance_models[k], mask });
+        }
+
+        GLuint count = static_cast<GLuint>(casters.size()) - baseInstance;
+        if (count == 0) continue;
+        commands.push_back({ static_cast<GLuint>(obj.mesh.indices.count),
+                             count,
+                             static_cast<GLuint>(obj.mesh.indices.first),
+                             obj.mesh.vertices.first,
+                             baseInstance });
+    }
+
+    // ==== Positions only, once for all of these layers ====
+    if (!commands.empty()) {
+        m_arena.setDepthInstances(casters);
+        m_arena.setDepthCommands(commands);
+        m_arena.bindDepth();
+        m_arena.drawDepth(GL_TRIANGLES, 0, static_cast<int>(commands.size()));
+        m_arena.unbind();
+    }
+}
+
+// ================================================================
+// Prefiltered exponential variance shadows. Each depth layer is
+// warped into moments (e^cz, e^2cz, -e^-cz, e^-2cz), blurred with a
+// separable Gaussian at full resolution and mipmapped, so the lookup
+// in default.frag is one trilinear fetch plus a Chebyshev bound.
+// ================================================================
+void Realtime::initializeShadowMoments() {
+    int layerCount = static_cast<int>(m_shadow_layer_lights.size());
+    int sliceCount = layerCount ? m_shadow_layer_slices.back() + 1 : 0;
+
+    glGenTextures(1, &m_shadow_moments);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_moments);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA16F, m_shadow_size, m_shadow_size, sliceCount, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (GLEW_EXT_texture_filter_anisotropic) {
+        glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, 8.0f);
+    }
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);   // allocate the chain
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    glGenTextures(1, &m_moments_scratch);
+    glBindTexture(GL_TEXTURE_2D, m_moments_scratch);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, m_shadow_size, m_shadow_size, 0, GL_RGBA, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
 
-            if (objIdx >= m_objects.size()) break;
-            GLShape &obj = m_objects[objIdx++];
+    // Texels outside a tiered layer's region are never filtered; start
+    // every layer at the moments of depth 1.0 (fully lit)
+    float pos = std::exp(EVSM_EXPONENT), neg = -std::exp(-EVSM_EXPONENT);
+    const GLfloat lit[4] = { pos, pos * pos, neg, neg * neg };
 
-            // SAME model matrix as in paintGeometry()
-            glm::mat4 model = obj.model;
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_moments);
+    for (int slice = 0; slice < sliceCount; slice++) {
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_shadow_moments, 0, slice);
+        glClearBufferfv(GL_COLOR, 0, lit);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
 
-            GLint locModel = glGetUniformLocation(m_shadow_shader, "model");
-            glUniformMatrix4fv(locModel, 1, GL_FALSE, &model[0][0]);
+    m_moment_stamps.assign(layerCount, 0);
+}
 
-            glBindVertexArray(obj.vao);
-            glDrawArrays(obj.mode, 0, obj.count);
+void Realtime::filterShadowMoments() {
+    if (!m_shadow_array || m_shadow_layer_lights.empty()) return;
+    if (!m_shadow_moments) initializeShadowMoments();
+
+    // Layers whose depth changed since they were last filtered
+    int nLayers = static_cast<int>(m_shadow_layer_lights.size());
+    std::vector<int> stale;
+    for (int layer = 0; layer < nLayers; layer++) {
+        if (m_shadow_stamps[layer] != 0 && m_moment_stamps[layer] != m_shadow_stamps[layer]) {
+            stale.push_back(layer);
         }
     }
+    if (stale.empty()) return;
+
+    const MomentsUniforms &u = m_moments_uniforms;
+
+    GLint oldViewport[4];
+    glGetIntegerv(GL_VIEWPORT, oldViewport);
+
+    glUseProgram(m_moments_shader);
+    glBindVertexArray(m_fullscreen_vao);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo_moments);
+    glDisable(GL_DEPTH_TEST);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_array);
+    glBindSampler(0, m_shadow_depth_sampler);
+
+    glUniform1i(u.depthLayers, 0);
+    glUniform1i(u.blurSource, 1);
+    glUniform1i(u.blurRadius, EVSM_BLUR_RADIUS);
+    glUniform2f(u.exponents, EVSM_EXPONENT, EVSM_EXPONENT);
+
+    glActiveTexture(GL_TEXTURE1);
+    for (int layer : stale) {
+        glm::ivec2 origin = shadowLayerOrigin(layer);
+        int region = m_shadow_size >> m_shadow_layer_tiers[layer];
+        glViewport(origin.x, origin.y, region, region);
+        glUniform1i(u.layer, m_shadow_layer_slices[layer]);
+        glUniform2i(u.origin, origin.x, origin.y);
+        glUniform1i(u.region, region);
+
+        // x: depth -> moments in the scratch target
+        glBindTexture(GL_TEXTURE_2D, 0);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_moments_scratch, 0);
+        glUniform1i(u.fromDepth, 1);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        // y: scratch -> the layer
+        glBindTexture(GL_TEXTURE_2D, m_moments_scratch);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_shadow_moments, 0, m_shadow_layer_slices[layer]);
+        glUniform1i(u.fromDepth, 0);
+        glDrawArrays(GL_TRIANGLES, 0, 6);
+
+        m_moment_stamps[layer] = m_shadow_stamps[layer];
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // GL only mipmaps whole arrays, so clean layers are rebuilt too
+    glActiveTexture(GL_TEXTURE0);
+    glBindSampler(0, 0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, m_shadow_moments);
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     // Restore state
+    glEnable(GL_DEPTH_TEST);
     glBindVertexArray(0);
     glBindFramebuffer(GL_FRAMEBUFFER, m_defaultFBO);
     glViewport(oldViewport[0], oldViewport[1],
@@ -1,9 +1,19 @@
 #include "Cone.h"
 
 void Cone::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
+    m_mesh = IndexedMesh();
     m_param1 = param1;
     m_param2 = param2;
+
+    // Slope: p1 rings of (p2 + 1) vertices plus one tip vertex per wedge.
+    // Cap: one center vertex plus p1 rings. Both the tip row and the
+    // innermost cap ring are fans, so each part has p2 * (2 * p1 - 1) triangles.
+    int columns = m_param2 + 1;
+    int slopeVertices = m_param1 * columns + m_param2;
+    int capVertices = 1 + m_param1 * columns;
+    int partTriangles = m_param2 * (2 * m_param1 - 1);
+    m_mesh.reserve(slopeVertices + capVertices, 3 * 2 * partTriangles);
+
     setVertexData();
 }
 
@@ -18,169 +28,113 @@ glm::vec3 Cone::calcNorm(glm::vec3& pt) {
     return glm::normalize(glm::vec3{ xNorm, yNorm, zNorm });
 }
 
-void Cone::makeCapTile(glm::vec3 topLeft,
-                       glm::vec3 topRight,
-                       glm::vec3 bottomLeft,
-                       glm::vec3 bottomRight) {
-    glm::vec3 normal(0.f, -1.f, 0.f);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
+// The tip has no well-defined normal; each wedge uses the average of the
+// implicit normals at its two base corners.
+glm::vec3 Cone::computeTipNormal(glm::vec3 bottomLeft, glm::vec3 bottomRight) {
+    return glm::normalize(calcNorm(bottomLeft) + calcNorm(bottomRight));
+}
 
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normal);
+void Cone::makeCapTile(uint32_t inner,
+                       uint32_t innerNext,
+                       uint32_t outer,
+                       uint32_t outerNext,
+                       bool isCenter) {
+    m_mesh.addTriangle(inner, outer, outerNext);
+    // At the center both inner corners are the same vertex
+    if (!isCenter) m_mesh.addTriangle(inner, outerNext, innerNext);
 }
 
-void Cone::makeSlopeTile(glm::vec3 topLeft,
-                         glm::vec3 topRight,
-                         glm::vec3 bottomLeft,
-                         glm::vec3 bottomRight)
+void Cone::makeSlopeTile(uint32_t topLeft,
+                         uint32_t topRight,
+                         uint32_t bottomLeft,
+                         uint32_t bottomRight,
+                         bool isTip)
 {
-    // Put all vertices in an array so we don’t care how the function is called.
-    glm::vec3 v[4] = { topLeft, topRight, bottomLeft, bottomRight };
-    glm::vec3 n[4];
-
-    const float eps = 1e-6f;
-
-    // Find the two base vertices (non-tip, r > 0)
-    int baseIdx[2];
-    int baseCount = 0;
-    for (int i = 0; i < 4; ++i) {
-        float r2 = v[i].x * v[i].x + v[i].z * v[i].z;
-        if (r2 > eps && baseCount < 2) {
-            baseIdx[baseCount++] = i;
-        }
-    }
-
-    // If we’re in the top slice (exactly 2 base vertices),
-    // build a special tip normal from their normals.
-    if (baseCount == 2) {
-        glm::vec3 baseN0 = calcNorm(v[baseIdx[0]]);
-        glm::vec3 baseN1 = calcNorm(v[baseIdx[1]]);
-        glm::vec3 tipNormal = glm::normalize(baseN0 + baseN1);
-
-        for (int i = 0; i < 4; ++i) {
-            float r2 = v[i].x * v[i].x + v[i].z * v[i].z;
-            if (r2 <= eps) {
-                // tip vertex
-                n[i] = tipNormal;
-            } else {
-                // base vertex
-                n[i] = calcNorm(v[i]);
-            }
-        }
-    } else {
-        // Regular slope tile: all vertices get the implicit cone normal
-        for (int i = 0; i < 4; ++i) {
-            n[i] = calcNorm(v[i]);
-        }
-    }
-
-    // Emit triangles using your original winding
-    // (your makeSlopeSlice calls are inverted on purpose).
-    insertVec3(m_vertexData, v[0]);
-    insertVec3(m_vertexData, n[0]);
-    insertVec3(m_vertexData, v[2]);
-    insertVec3(m_vertexData, n[2]);
-    insertVec3(m_vertexData, v[3]);
-    insertVec3(m_vertexData, n[3]);
-
-    insertVec3(m_vertexData, v[0]);
-    insertVec3(m_vertexData, n[0]);
-    insertVec3(m_vertexData, v[3]);
-    insertVec3(m_vertexData, n[3]);
-    insertVec3(m_vertexData, v[1]);
-    insertVec3(m_vertexData, n[1]);
+    // makeSlope() passes the lower ring as "top", matching the original winding.
+    // In the tip row bottomLeft == bottomRight, leaving a single triangle.
+    if (!isTip) m_mesh.addTriangle(topLeft, bottomLeft, bottomRight);
+    m_mesh.addTriangle(topLeft, bottomRight, topRight);
 }
 
-void Cone::makeCapSlice(float currentTheta, float nextTheta){
+void Cone::makeCap() {
     // Task 8: create a slice of the cap face using your
     //         make tile function(s)
     // Note: think about how param 1 comes into play here!
-    float radius = 0.5f;
     float y = -0.5f; // base of the cone
+    float rStep = m_radius / (float)m_param1;
+    float thetaStep = glm::radians(360.f / (float)m_param2);
+    glm::vec3 normal(0.f, -1.f, 0.f);
 
-    // Step size for radius subdivision
-    float rStep = radius / (float)m_param1;
-
-    for (int i = 0; i < m_param1; i++) {
-        float r1 = i * rStep;
-        float r2 = (i + 1) * rStep;
+    int columns = m_param2 + 1;
+    uint32_t center = m_mesh.addVertex(glm::vec3(0.f, y, 0.f), normal);
+    for (int i = 1; i <= m_param1; i++) {
+        float r = i * rStep;
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            m_mesh.addVertex(glm::vec3(r * glm::cos(theta), y, r * glm::sin(theta)), normal);
+        }
+    }
 
-        // Compute four corners of the current tile
-        glm::vec3 topLeft(r1 * glm::cos(currentTheta), y, r1 * glm::sin(currentTheta));
-        glm::vec3 topRight(r1 * glm::cos(nextTheta),   y, r1 * glm::sin(nextTheta));
-        glm::vec3 bottomLeft(r2 * glm::cos(currentTheta), y, r2 * glm::sin(currentTheta));
-        glm::vec3 bottomRight(r2 * glm::cos(nextTheta),   y, r2 * glm::sin(nextTheta));
+    // Ring i (1-based) column j lives at center + 1 + (i - 1) * columns + j
+    for (int j = 0; j < m_param2; j++) {
+        for (int i = 0; i < m_param1; i++) {
+            uint32_t inner = i == 0 ? center : center + 1 + (i - 1) * columns + j;
+            uint32_t innerNext = i == 0 ? center : inner + 1;
+            uint32_t outer = center + 1 + i * columns + j;
 
-        // Add this ring segment
-        makeCapTile(topLeft, topRight, bottomLeft, bottomRight);
+            makeCapTile(inner, innerNext, outer, outer + 1, i == 0);
+        }
     }
 }
 
-void Cone::makeSlopeSlice(float currentTheta, float nextTheta){
+void Cone::makeSlope() {
     // Task 9: create a single sloped face using your make
     //         tile function(s)
     // Note: think about how param 1 comes into play here!
     float height = 1.0f;
     float yBase = -0.5f;
     float yStep = height / (float)m_param1;
-    float rStep = 0.5f / (float)m_param1;
+    float rStep = m_radius / (float)m_param1;
+    float thetaStep = glm::radians(360.f / (float)m_param2);
 
+    // Rings from the base up to (but excluding) the tip
+    int columns = m_param2 + 1;
+    uint32_t base = m_mesh.vertexCount();
     for (int i = 0; i < m_param1; i++) {
-        float rBottom = 0.5f - i * rStep;
-        float rTop = 0.5f - (i + 1) * rStep;
-
-        float yBottomCurr = yBase + i * yStep;
-        float yTopCurr = yBase + (i + 1) * yStep;
-
-        glm::vec3 bottomLeft(rBottom * glm::cos(currentTheta), yBottomCurr, rBottom * glm::sin(currentTheta));
-        glm::vec3 bottomRight(rBottom * glm::cos(nextTheta),   yBottomCurr, rBottom * glm::sin(nextTheta));
-        glm::vec3 topLeft(rTop * glm::cos(currentTheta), yTopCurr, rTop * glm::sin(currentTheta));
-        glm::vec3 topRight(rTop * glm::cos(nextTheta),   yTopCurr, rTop * glm::sin(nextTheta));
-
-        makeSlopeTile(bottomLeft, bottomRight, topLeft, topRight);
+        float r = m_radius - i * rStep;
+        float y = yBase + i * yStep;
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 pos(r * glm::cos(theta), y, r * glm::sin(theta));
+            m_mesh.addVertex(pos, calcNorm(pos));
+        }
     }
-}
 
-void Cone::makeWedge(float currentTheta, float nextTheta) {
-    // Task 10: create a single wedge of the Cone using the
-    //          makeCapSlice() and makeSlopeSlice() functions you
-    //          implemented in Task 5
-    makeSlopeSlice(currentTheta, nextTheta);
-    makeCapSlice(currentTheta, nextTheta);
-}
-
-void Cone::setVertexData() {
-    // Task 10: create a full cone using the makeWedge() function you
-    //          just implemented
-    // Note: think about how param 2 comes into play here!
-    float thetaStep = glm::radians(360.f / (float)m_param2);
+    // One tip vertex per wedge, each with that wedge's averaged normal
+    uint32_t lastRing = base + (m_param1 - 1) * columns;
+    uint32_t tips = m_mesh.vertexCount();
+    for (int j = 0; j < m_param2; j++) {
+        const float *left = &m_mesh.vertices[(lastRing + j) * IndexedMesh::FLOATS_PER_VERTEX];
+        const float *right = left + IndexedMesh::FLOATS_PER_VERTEX;
+        glm::vec3 normal = computeTipNormal(glm::vec3(left[0], left[1], left[2]),
+                                            glm::vec3(right[0], right[1], right[2]));
+        m_mesh.addVertex(glm::vec3(0.f, yBase + height, 0.f), normal);
+    }
 
-    for (int i = 0; i < m_param2; ++i) {
-        float currentTheta = i * thetaStep;
-        float nextTheta = (i + 1) * thetaStep;
+    for (int j = 0; j < m_param2; j++) {
+        for (int i = 0; i < m_param1; i++) {
+            uint32_t bottomLeft = base + i * columns + j;
+            bool isTip = i == m_param1 - 1;
+            uint32_t topLeft = isTip ? tips + j : bottomLeft + columns;
+            uint32_t topRight = isTip ? tips + j : topLeft + 1;
 
-        makeWedge(currentTheta, nextTheta);
+            makeSlopeTile(bottomLeft, bottomLeft + 1, topLeft, topRight, isTip);
+        }
     }
 }
 
-// Inserts a glm::vec3 into a vector of floats.
-// This will come in handy if you want to take advantage of vectors to build your shape!
-void Cone::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
+void Cone::setVertexData() {
+    // Task 10: create a full cone from the sloped face and the cap
+    makeSlope();
+    makeCap();
 }
@@ -3,24 +3,25 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "IndexedMesh.h"
+
 class Cone
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    // Moves the mesh out; call updateParams() again before reuse
+    IndexedMesh generateShape() { return std::move(m_mesh); }
 
 private:
-    void insertVec3(std::vector<float> &data, glm::vec3 v);
     void setVertexData();
-    void makeCapSlice(float currentTheta, float nextTheta);
-    void makeSlopeSlice(float currentTheta, float nextTheta);
-    void makeWedge(float currentTheta, float nextTheta);
-    void makeCapTile(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight);
-    void makeSlopeTile(glm::vec3 topLeft, glm::vec3 topRight, glm::vec3 bottomLeft, glm::vec3 bottomRight);
+    void makeCap();
+    void makeSlope();
+    void makeCapTile(uint32_t inner, uint32_t innerNext, uint32_t outer, uint32_t outerNext, bool isCenter);
+    void makeSlopeTile(uint32_t topLeft, uint32_t topRight, uint32_t bottomLeft, uint32_t bottomRight, bool isTip);
     glm::vec3 calcNorm(glm::vec3& pt);
     glm::vec3 computeTipNormal(glm::vec3 bottomLeft, glm::vec3 bottomRight);
 
-    std::vector<float> m_vertexData;
+    IndexedMesh m_mesh;
     int m_param1;
     int m_param2;
     float m_radius = 0.5;
@@ -1,36 +1,23 @@
 #include "Cube.h"
 
 void Cube::updateParams(int param1) {
-    m_vertexData = std::vector<float>();
+    m_mesh = IndexedMesh();
     m_param1 = param1;
+
+    // 6 faces, each a (p1 + 1)^2 vertex grid with p1^2 tiles
+    int side = m_param1 + 1;
+    m_mesh.reserve(6 * side * side, 6 * m_param1 * m_param1 * 6);
+
     setVertexData();
 }
 
-void Cube::makeTile(glm::vec3 topLeft,
-                    glm::vec3 topRight,
-                    glm::vec3 bottomLeft,
-                    glm::vec3 bottomRight) {
+void Cube::makeTile(uint32_t topLeft,
+                    uint32_t topRight,
+                    uint32_t bottomLeft,
+                    uint32_t bottomRight) {
     // Task 2: create a tile (i.e. 2 triangles) based on 4 given points.
-
-    glm::vec3 normal = glm::normalize(glm::cross(bottomLeft - topLeft, bottomRight - topLeft));
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normal);
+    m_mesh.addTriangle(topLeft, bottomLeft, bottomRight);
+    m_mesh.addTriangle(topLeft, bottomRight, topRight);
 }
 
 void Cube::makeFace(glm::vec3 topLeft,
@@ -44,34 +31,28 @@ void Cube::makeFace(glm::vec3 topLeft,
     glm::vec3 stepX = (topRight - topLeft) / (float)m_param1;
     glm::vec3 stepY = (bottomLeft - topLeft) / (float)m_param1;
 
+    // Flat face: every grid vertex shares the face normal
+    glm::vec3 normal = glm::normalize(glm::cross(bottomLeft - topLeft, bottomRight - topLeft));
+
+    int side = m_param1 + 1;
+    uint32_t base = m_mesh.vertexCount();
+    for (int i = 0; i <= m_param1; i++) {
+        for (int j = 0; j <= m_param1; j++) {
+            m_mesh.addVertex(topLeft + (float)j * stepX + (float)i * stepY, normal);
+        }
+    }
+
     for (int i = 0; i < m_param1; i++) {
         for (int j = 0; j < m_param1; j++) {
-            glm::vec3 currTopLeft = topLeft + (float)j * stepX + (float)i * stepY;
-            glm::vec3 currTopRight = currTopLeft + stepX;
-            glm::vec3 currBottomLeft = currTopLeft + stepY;
-            glm::vec3 currBottomRight = currBottomLeft + stepX;
+            uint32_t currTopLeft = base + i * side + j;
+            uint32_t currBottomLeft = currTopLeft + side;
 
-            makeTile(currTopLeft, currTopRight, currBottomLeft, currBottomRight);
+            makeTile(currTopLeft, currTopLeft + 1, currBottomLeft, currBottomLeft + 1);
         }
     }
-
 }
 
 void Cube::setVertexData() {
-    // Uncomment these lines for Task 2, then comment them out for Task 3:
-
-    // makeTile(glm::vec3(-0.5f,  0.5f, 0.5f),
-    //          glm::vec3( 0.5f,  0.5f, 0.5f),
-    //          glm::vec3(-0.5f, -0.5f, 0.5f),
-    //          glm::vec3( 0.5f, -0.5f, 0.5f));
-
-    // Uncomment these lines for Task 3:
-
-    makeFace(glm::vec3(-0.5f,  0.5f, 0.5f),
-             glm::vec3( 0.5f,  0.5f, 0.5f),
-             glm::vec3(-0.5f, -0.5f, 0.5f),
-             glm::vec3( 0.5f, -0.5f, 0.5f));
-
     // Task 4: Use the makeFace() function to make all 6 sides of the cube
 
     makeFace(glm::vec3(-0.5f,  0.5f,  0.5f),
@@ -104,11 +85,3 @@ void Cube::setVertexData() {
              glm::vec3(-0.5f, -0.5f, -0.5f),
              glm::vec3( 0.5f, -0.5f, -0.5f));
 }
-
-// Inserts a glm::vec3 into a vector of floats.
-// This will come in handy if you want to take advantage of vectors to build your shape!
-void Cube::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
-}
@@ -3,24 +3,26 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "IndexedMesh.h"
+
 class Cube
 {
 public:
     void updateParams(int param1);
-    std::vector<float> generateShape() { return m_vertexData; }
+    // Moves the mesh out; call updateParams() again before reuse
+    IndexedMesh generateShape() { return std::move(m_mesh); }
 
 private:
-    void insertVec3(std::vector<float> &data, glm::vec3 v);
     void setVertexData();
-    void makeTile(glm::vec3 topLeft,
-                  glm::vec3 topRight,
-                  glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
+    void makeTile(uint32_t topLeft,
+                  uint32_t topRight,
+                  uint32_t bottomLeft,
+                  uint32_t bottomRight);
     void makeFace(glm::vec3 topLeft,
                   glm::vec3 topRight,
                   glm::vec3 bottomLeft,
                   glm::vec3 bottomRight);
 
-    std::vector<float> m_vertexData;
+    IndexedMesh m_mesh;
     int m_param1;
 };
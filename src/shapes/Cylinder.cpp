@@ -3,9 +3,19 @@
 #include <cmath>
 
 void Cylinder::updateParams(int param1, int param2) {
-    m_vertexData = std::vector<float>();
+    m_mesh = IndexedMesh();
     m_param1 = param1;
     m_param2 = param2;
+
+    // Side: (p1 + 1) x (p2 + 1) grid. Caps: one center vertex plus p1 rings,
+    // and p2 * (2 * p1 - 1) triangles since the innermost ring is a fan.
+    int columns = m_param2 + 1;
+    int sideVertices = (m_param1 + 1) * columns;
+    int capVertices = 1 + m_param1 * columns;
+    int sideTriangles = 2 * m_param1 * m_param2;
+    int capTriangles = m_param2 * (2 * m_param1 - 1);
+    m_mesh.reserve(sideVertices + 2 * capVertices, 3 * (sideTriangles + 2 * capTriangles));
+
     setVertexData();
 }
 
@@ -13,118 +23,88 @@ glm::vec3 Cylinder::calcNorm(glm::vec3& pt) {
     return glm::normalize(glm::vec3(pt.x, 0.f, pt.z));
 }
 
-void Cylinder::makeCapTile(glm::vec3 topLeft,
-                           glm::vec3 topRight,
-                           glm::vec3 bottomLeft,
-                           glm::vec3 bottomRight,
-                           bool isTop) {
-    glm::vec3 normal = isTop ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(0.f, -1.f, 0.f);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normal);
-
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normal);
+void Cylinder::makeCapTile(uint32_t inner,
+                           uint32_t innerNext,
+                           uint32_t outer,
+                           uint32_t outerNext,
+                           bool isTop,
+                           bool isCenter) {
+    // At the center both inner corners are the same vertex, leaving one triangle
+    if (isTop) {
+        if (!isCenter) m_mesh.addTriangle(outer, inner, innerNext);
+        m_mesh.addTriangle(outer, innerNext, outerNext);
+    } else {
+        m_mesh.addTriangle(inner, outer, outerNext);
+        if (!isCenter) m_mesh.addTriangle(inner, outerNext, innerNext);
+    }
 }
 
-void Cylinder::makeSideTile(glm::vec3 topLeft,
-                            glm::vec3 topRight,
-                            glm::vec3 bottomLeft,
-                            glm::vec3 bottomRight) {
-    glm::vec3 normalTL = calcNorm(topLeft);
-    glm::vec3 normalTR = calcNorm(topRight);
-    glm::vec3 normalBL = calcNorm(bottomLeft);
-    glm::vec3 normalBR = calcNorm(bottomRight);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normalTL);
-
-    insertVec3(m_vertexData, bottomLeft);
-    insertVec3(m_vertexData, normalBL);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normalBR);
-
-    insertVec3(m_vertexData, topLeft);
-    insertVec3(m_vertexData, normalTL);
-
-    insertVec3(m_vertexData, bottomRight);
-    insertVec3(m_vertexData, normalBR);
-
-    insertVec3(m_vertexData, topRight);
-    insertVec3(m_vertexData, normalTR);
+void Cylinder::makeSideTile(uint32_t topLeft,
+                            uint32_t topRight,
+                            uint32_t bottomLeft,
+                            uint32_t bottomRight) {
+    m_mesh.addTriangle(topLeft, bottomLeft, bottomRight);
+    m_mesh.addTriangle(topLeft, bottomRight, topRight);
 }
 
-void Cylinder::makeCapSlice(float currentTheta, float nextTheta, bool isTop) {
-    float radius = 0.5f;
+void Cylinder::makeCap(bool isTop) {
     float y = isTop ? 0.5f : -0.5f;
-    float rStep = radius / (float)m_param1;
+    float rStep = m_radius / (float)m_param1;
+    float thetaStep = glm::radians(360.f / (float)m_param2);
+    glm::vec3 normal = isTop ? glm::vec3(0.f, 1.f, 0.f) : glm::vec3(0.f, -1.f, 0.f);
 
-    for (int i = 0; i < m_param1; i++) {
-        float r1 = i * rStep;
-        float r2 = (i + 1) * rStep;
+    int columns = m_param2 + 1;
+    uint32_t center = m_mesh.addVertex(glm::vec3(0.f, y, 0.f), normal);
+    for (int i = 1; i <= m_param1; i++) {
+        float r = i * rStep;
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            m_mesh.addVertex(glm::vec3(r * glm::cos(theta), y, r * glm::sin(theta)), normal);
+        }
+    }
 
-        glm::vec3 topLeft(r1 * glm::cos(currentTheta), y, r1 * glm::sin(currentTheta));
-        glm::vec3 topRight(r1 * glm::cos(nextTheta),   y, r1 * glm::sin(nextTheta));
-        glm::vec3 bottomLeft(r2 * glm::cos(currentTheta), y, r2 * glm::sin(currentTheta));
-        glm::vec3 bottomRight(r2 * glm::cos(nextTheta),   y, r2 * glm::sin(nextTheta));
+    // Ring i (1-based) column j lives at center + 1 + (i - 1) * columns + j
+    for (int j = 0; j < m_param2; j++) {
+        for (int i = 0; i < m_param1; i++) {
+            uint32_t inner = i == 0 ? center : center + 1 + (i - 1) * columns + j;
+            uint32_t innerNext = i == 0 ? center : inner + 1;
+            uint32_t outer = center + 1 + i * columns + j;
 
-        if (isTop)
-            makeCapTile(bottomLeft, bottomRight, topLeft, topRight, true);
-        else
-            makeCapTile(topLeft, topRight, bottomLeft, bottomRight, false);
+            makeCapTile(inner, innerNext, outer, outer + 1, isTop, i == 0);
+        }
     }
 }
 
-void Cylinder::makeSideSlice(float currentTheta, float nextTheta) {
+void Cylinder::makeSide() {
     float height = 1.0f;
     float yBase = -0.5f;
     float yStep = height / (float)m_param1;
+    float thetaStep = glm::radians(360.f / (float)m_param2);
 
-    for (int i = 0; i < m_param1; i++) {
-        float yBottom = yBase + i * yStep;
-        float yTop = yBase + (i + 1) * yStep;
-
-        glm::vec3 bottomLeft(0.5f * glm::cos(currentTheta), yBottom, 0.5f * glm::sin(currentTheta));
-        glm::vec3 bottomRight(0.5f * glm::cos(nextTheta),   yBottom, 0.5f * glm::sin(nextTheta));
-        glm::vec3 topLeft(0.5f * glm::cos(currentTheta), yTop, 0.5f * glm::sin(currentTheta));
-        glm::vec3 topRight(0.5f * glm::cos(nextTheta),   yTop, 0.5f * glm::sin(nextTheta));
-
-        makeSideTile(bottomLeft, bottomRight, topLeft, topRight);
+    int columns = m_param2 + 1;
+    uint32_t base = m_mesh.vertexCount();
+    for (int i = 0; i <= m_param1; i++) {
+        float y = yBase + i * yStep;
+        for (int j = 0; j <= m_param2; j++) {
+            float theta = j * thetaStep;
+            glm::vec3 pos(m_radius * glm::cos(theta), y, m_radius * glm::sin(theta));
+            m_mesh.addVertex(pos, calcNorm(pos));
+        }
     }
-}
 
-void Cylinder::makeWedge(float currentTheta, float nextTheta) {
-    makeSideSlice(currentTheta, nextTheta);
-    makeCapSlice(currentTheta, nextTheta, true);   // top
-    makeCapSlice(currentTheta, nextTheta, false);  // bottom
-}
+    // Rows run bottom to top, so the tile's "top" edge is the lower ring
+    for (int j = 0; j < m_param2; j++) {
+        for (int i = 0; i < m_param1; i++) {
+            uint32_t bottomLeft = base + i * columns + j;
+            uint32_t topLeft = bottomLeft + columns;
 
-void Cylinder::setVertexData() {
-    float thetaStep = glm::radians(360.f / (float)m_param2);
-
-    for (int i = 0; i < m_param2; ++i) {
-        float currentTheta = i * thetaStep;
-        float nextTheta = (i + 1) * thetaStep;
-
-        makeWedge(currentTheta, nextTheta);
+            makeSideTile(bottomLeft, bottomLeft + 1, topLeft, topLeft + 1);
+        }
     }
 }
 
-void Cylinder::insertVec3(std::vector<float> &data, glm::vec3 v) {
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
+void Cylinder::setVertexData() {
+    makeSide();
+    makeCap(true);    // top
+    makeCap(false);   // bottom
 }
@@ -3,34 +3,36 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "IndexedMesh.h"
+
 class Cylinder
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    // Moves the mesh out; call updateParams() again before reuse
+    IndexedMesh generateShape() { return std::move(m_mesh); }
 
 private:
     // Core shape builders
     void setVertexData();
-    void makeWedge(float currentTheta, float nextTheta);
-    void makeSideSlice(float currentTheta, float nextTheta);
-    void makeCapSlice(float currentTheta, float nextTheta, bool isTop);
-    void makeSideTile(glm::vec3 topLeft,
-                      glm::vec3 topRight,
-                      glm::vec3 bottomLeft,
-                      glm::vec3 bottomRight);
-    void makeCapTile(glm::vec3 topLeft,
-                     glm::vec3 topRight,
-                     glm::vec3 bottomLeft,
-                     glm::vec3 bottomRight,
-                     bool isTop);
+    void makeSide();
+    void makeCap(bool isTop);
+    void makeSideTile(uint32_t topLeft,
+                      uint32_t topRight,
+                      uint32_t bottomLeft,
+                      uint32_t bottomRight);
+    void makeCapTile(uint32_t inner,
+                     uint32_t innerNext,
+                     uint32_t outer,
+                     uint32_t outerNext,
+                     bool isTop,
+                     bool isCenter);
 
     // Utility
     glm::vec3 calcNorm(glm::vec3& pt);
-    void insertVec3(std::vector<float>& data, glm::vec3 v);
 
     // Members
-    std::vector<float> m_vertexData;
+    IndexedMesh m_mesh;
     int m_param1;
     int m_param2;
     float m_radius = 0.5f;
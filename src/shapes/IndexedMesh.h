@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+
+// Interleaved pos(3) + normal(3) vertices with a triangle index list.
+// Generators reserve the exact vertex and index counts up front.
+struct IndexedMesh
+{
+    static constexpr int FLOATS_PER_VERTEX = 6;
+
+    std::vector<float> vertices;
+    std::vector<uint32_t> indices;
+
+    void reserve(size_t vertexCount, size_t indexCount) {
+        vertices.reserve(vertexCount * FLOATS_PER_VERTEX);
+        indices.reserve(indexCount);
+    }
+
+    uint32_t vertexCount() const {
+        return static_cast<uint32_t>(vertices.size() / FLOATS_PER_VERTEX);
+    }
+
+    uint32_t addVertex(glm::vec3 pos, glm::vec3 normal) {
+        uint32_t index = vertexCount();
+        vertices.insert(vertices.end(), { pos.x, pos.y, pos.z, normal.x, normal.y, normal.z });
+        return index;
+    }
+
+    void addTriangle(uint32_t a, uint32_t b, uint32_t c) {
+        indices.insert(indices.end(), { a, b, c });
+    }
+};
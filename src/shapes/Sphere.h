@@ -3,23 +3,23 @@
 #include <vector>
 #include <glm/glm.hpp>
 
+#include "IndexedMesh.h"
+
 class Sphere
 {
 public:
     void updateParams(int param1, int param2);
-    std::vector<float> generateShape() { return m_vertexData; }
+    // Moves the mesh out; call updateParams() again before reuse
+    IndexedMesh generateShape() { return std::move(m_mesh); }
 
 private:
-    void insertVec3(std::vector<float> &data, glm::vec3 v);
     void setVertexData();
-    void makeTile(glm::vec3 topLeft,
-                  glm::vec3 topRight,
-                  glm::vec3 bottomLeft,
-                  glm::vec3 bottomRight);
-    void makeWedge(float currTheta, float nextTheta);
+    void makeTile(int row, int column);
+    void makeWedge(int column);
     void makeSphere();
+    uint32_t gridIndex(int row, int column) const { return row * (m_param2 + 1) + column; }
 
-    std::vector<float> m_vertexData;
+    IndexedMesh m_mesh;
     float m_radius = 0.5;
     int m_param1;
     int m_param2;
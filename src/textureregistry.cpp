@@ -0,0 +1,76 @@
+#include "textureregistry.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+// ====================== Core API ======================
+
+int TextureRegistry::acquire(const SceneFileMap &map) {
+    if (!map.isUsed || map.filename.empty()) return -1;
+
+    auto it = m_handles.find(map.filename);
+    if (it != m_handles.end()) return it->second;
+
+    // OBJ materials arrive already decoded; JSON primitives only carry a path
+    QImage image = map.texture;
+    if (image.isNull()) {
+        image = QImage(QString::fromStdString(map.filename));
+        if (image.isNull()) {
+            std::cerr << "Failed to load texture: " << map.filename << std::endl;
+            m_handles.emplace(map.filename, -1);
+            return -1;
+        }
+        image = image.convertToFormat(QImage::Format_RGBA8888).mirrored();
+    } else if (image.format() != QImage::Format_RGBA8888) {
+        image = image.convertToFormat(QImage::Format_RGBA8888);
+    }
+
+    int handle = static_cast<int>(m_textures.size());
+    m_textures.push_back(upload(image));
+    m_handles.emplace(map.filename, handle);
+    return handle;
+}
+
+void TextureRegistry::clear() {
+    if (!m_textures.empty()) {
+        glDeleteTextures(static_cast<GLsizei>(m_textures.size()), m_textures.data());
+    }
+    m_textures.clear();
+    m_handles.clear();
+}
+
+// ====================== Helpers ======================
+
+GLuint TextureRegistry::upload(const QImage &image) const {
+    int w = image.width();
+    int h = image.height();
+    GLsizei levels = 1 + static_cast<GLsizei>(std::floor(std::log2(std::max(w, h))));
+
+    GLuint tex = 0;
+    glGenTextures(1, &tex);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, tex);
+
+    // constBits() never detaches, so the image is read in place
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (GLEW_ARB_texture_storage) {
+        glTexStorage2D(GL_TEXTURE_2D, levels, GL_RGBA8, w, h);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, w, h,
+                        GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+    } else {
+        // GL 4.1 (macOS) fallback: mutable storage, but still uploaded once
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, image.constBits());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+    glGenerateMipmap(GL_TEXTURE_2D);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return tex;
+}
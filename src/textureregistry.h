@@ -0,0 +1,41 @@
+#pragma once
+
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+
+#include <GL/glew.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "utils/scenedata.h"
+
+// ---------------------------------------------------------------------------
+// TextureRegistry: one immutable, mipmapped GL texture per unique image file.
+// Textures are created once at scene-load time; shapes keep an integer handle
+// and the per-draw cost is a single glBindTexture.
+// ---------------------------------------------------------------------------
+
+class TextureRegistry {
+public:
+    TextureRegistry() = default;
+
+    // Returns a handle for the texture map, uploading it on first use.
+    // Returns -1 if the map is unused or the image cannot be loaded.
+    int acquire(const SceneFileMap &map);
+
+    // GL texture name for a handle (0 for invalid handles)
+    GLuint texture(int handle) const {
+        return (handle >= 0 && handle < (int)m_textures.size()) ? m_textures[handle] : 0;
+    }
+
+    // Deletes every texture (call with the GL context current)
+    void clear();
+
+private:
+    std::vector<GLuint> m_textures;
+    std::unordered_map<std::string, int> m_handles;   // file -> handle
+
+    GLuint upload(const QImage &image) const;
+};
@@ -0,0 +1,562 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+
+#include "objloader.h"
+
+#include <QFile>
+#include <QString>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <map>
+#include <thread>
+
+namespace {
+
+constexpr size_t MIN_CHUNK_BYTES = 1 << 20;   // below this, threads cost more than they save
+
+// Runs fn(begin, end) over [0, count) split across up to one task per core
+template <typename Fn>
+void parallelFor(size_t count, size_t minPerTask, Fn &&fn) {
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t tasks = std::clamp(count / std::max<size_t>(minPerTask, 1), size_t(1), workers);
+    if (tasks == 1) {
+        fn(size_t(0), count);
+        return;
+    }
+
+    std::vector<std::future<void>> jobs;
+    jobs.reserve(tasks - 1);
+    for (size_t i = 1; i < tasks; i++) {
+        size_t begin = count * i / tasks, end = count * (i + 1) / tasks;
+        jobs.push_back(std::async(std::launch::async, [&fn, begin, end] { fn(begin, end); }));
+    }
+    fn(size_t(0), count / tasks);
+    for (std::future<void> &job : jobs) job.get();
+}
+
+// ====================== Lexing ======================
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+inline bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+inline const char *skipSpace(const char *p, const char *end) {
+    while (p < end && isSpace(*p)) p++;
+    return p;
+}
+
+// Rest of the line without surrounding whitespace
+std::string restOfLine(const char *p, const char *end) {
+    p = skipSpace(p, end);
+    while (end > p && isSpace(end[-1])) end--;
+    return std::string(p, end);
+}
+
+constexpr double POW10[] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+// Locale-independent decimal/scientific parser. Accumulates up to 19
+// significant digits and applies one power of ten, which is well within
+// float precision. Returns p unchanged if no number is present.
+const char *parseFloat(const char *p, const char *end, float &out) {
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+
+    uint64_t mantissa = 0;
+    int exponent = 0, digits = 0;
+    bool any = false;
+
+    for (; p < end && isDigit(*p); p++, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        } else {
+            exponent++;
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && isDigit(*p); p++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return start;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool negExp = false;
+        if (q < end && (*q == '-' || *q == '+')) negExp = (*q++ == '-');
+        if (q < end && isDigit(*q)) {
+            int e = 0;
+            for (; q < end && isDigit(*q); q++) e = std::min(e * 10 + (*q - '0'), 1000);
+            exponent += negExp ? -e : e;
+            p = q;
+        }
+    }
+
+    double value = double(mantissa);
+    if (exponent < 0) {
+        for (; exponent < -22; exponent += 22) value /= POW10[22];
+        value /= POW10[-exponent];
+    } else {
+        for (; exponent > 22; exponent -= 22) value *= POW10[22];
+        value *= POW10[exponent];
+    }
+
+    out = float(negative ? -value : value);
+    return p;
+}
+
+const char *parseInt(const char *p, const char *end, int &out) {
+    const char *start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) negative = (*p++ == '-');
+    if (p == end || !isDigit(*p)) return start;
+
+    int value = 0;
+    for (; p < end && isDigit(*p); p++) value = value * 10 + (*p - '0');
+    out = negative ? -value : value;
+    return p;
+}
+
+// ====================== Chunk parsing ======================
+
+// Negative OBJ indices count back from the attributes seen so far, which a
+// chunk only knows relative to its own start. Such indices are stored
+// chunk-local and flagged, then offset once every chunk's counts are known.
+enum RelativeFlags : uint8_t { REL_V = 1, REL_VT = 2, REL_VN = 4 };
+
+struct Chunk {
+    std::vector<float> positions, normals, texcoords;
+    std::vector<ObjIndex> corners;           // polygon corners, triangulated during the stitch
+    std::vector<uint8_t> relative;           // RelativeFlags per corner
+    std::vector<uint8_t> polygonSizes;
+    std::vector<int> materials;              // per polygon; -1 = material active at chunk start
+    std::vector<std::string> materialNames;
+    std::vector<std::pair<size_t, std::string>> groups;   // (chunk triangle, name)
+    std::vector<std::string> mtllibs;
+    size_t triangleCount = 0;
+    int endMaterial = -1;                    // usemtl in effect after the last line
+};
+
+inline int resolveIndex(int raw, size_t seen, uint8_t flag, uint8_t &relative) {
+    if (raw > 0) return raw - 1;
+    if (raw < 0) {
+        relative |= flag;
+        return int(seen) + raw;   // may be negative: refers to an earlier chunk
+    }
+    return -1;
+}
+
+constexpr int MAX_POLYGON = 255;
+
+void parseFace(const char *p, const char *end, Chunk &c, int material) {
+    const size_t nv = c.positions.size() / 3, nvt = c.texcoords.size() / 2, nvn = c.normals.size() / 3;
+    const size_t first = c.corners.size();
+
+    while ((p = skipSpace(p, end)) < end && c.corners.size() - first < MAX_POLYGON) {
+        int v = 0, vt = 0, vn = 0;
+        const char *q = parseInt(p, end, v);
+        if (q == p) break;
+        if (q < end && *q == '/') {
+            q = parseInt(q + 1, end, vt);
+            if (q < end && *q == '/') q = parseInt(q + 1, end, vn);
+        }
+        while (q < end && !isSpace(*q)) q++;   // tolerate junk after a corner
+        p = q;
+
+        uint8_t flags = 0;
+        ObjIndex index;
+        index.v  = resolveIndex(v,  nv,  REL_V,  flags);
+        index.vt = resolveIndex(vt, nvt, REL_VT, flags);
+        index.vn = resolveIndex(vn, nvn, REL_VN, flags);
+        c.corners.push_back(index);
+        c.relative.push_back(flags);
+    }
+
+    size_t n = c.corners.size() - first;
+    if (n < 3) {   // degenerate, dropped like tinyobj does
+        c.corners.resize(first);
+        c.relative.resize(first);
+        return;
+    }
+    c.polygonSizes.push_back(uint8_t(n));
+    c.materials.push_back(material);
+    c.triangleCount += n - 2;
+}
+
+void parseChunk(const char *p, const char *end, Chunk &c) {
+    int material = -1;
+
+    while (p < end) {
+        const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!eol) eol = end;
+
+        const char *s = skipSpace(p, eol);
+        p = eol + 1;
+        if (eol - s < 2) continue;
+
+        float x = 0.f, y = 0.f, z = 0.f;
+        if (s[0] == 'v' && isSpace(s[1])) {
+            s = parseFloat(skipSpace(s + 2, eol), eol, x);
+            s = parseFloat(skipSpace(s, eol), eol, y);
+            parseFloat(skipSpace(s, eol), eol, z);
+            c.positions.insert(c.positions.end(), { x, y, z });
+        } else if (s[0] == 'v' && s[1] == 'n') {
+            s = parseFloat(skipSpace(s + 2, eol), eol, x);
+            s = parseFloat(skipSpace(s, eol), eol, y);
+            parseFloat(skipSpace(s, eol), eol, z);
+            c.normals.insert(c.normals.end(), { x, y, z });
+        } else if (s[0] == 'v' && s[1] == 't') {
+            s = parseFloat(skipSpace(s + 2, eol), eol, x);
+            parseFloat(skipSpace(s, eol), eol, y);
+            c.texcoords.insert(c.texcoords.end(), { x, y });
+        } else if (s[0] == 'f' && isSpace(s[1])) {
+            parseFace(s + 2, eol, c, material);
+        } else if ((s[0] == 'o' || s[0] == 'g') && isSpace(s[1])) {
+            c.groups.emplace_back(c.triangleCount, restOfLine(s + 2, eol));
+        } else if (eol - s > 7 && std::strncmp(s, "usemtl", 6) == 0 && isSpace(s[6])) {
+            std::string name = restOfLine(s + 7, eol);
+            auto it = std::find(c.materialNames.begin(), c.materialNames.end(), name);
+            material = int(it - c.materialNames.begin());
+            if (it == c.materialNames.end()) c.materialNames.push_back(name);
+        } else if (eol - s > 7 && std::strncmp(s, "mtllib", 6) == 0 && isSpace(s[6])) {
+            c.mtllibs.push_back(restOfLine(s + 7, eol));
+        }
+    }
+
+    c.endMaterial = material;
+}
+
+// tinyobj splits a quad along its shorter diagonal; true when that is 1-3
+bool splitQuadAlong13(const std::vector<float> &positions, const ObjIndex *quad) {
+    const size_t nv = positions.size() / 3;
+    glm::vec3 p[4];
+    for (int k = 0; k < 4; k++) {
+        if (quad[k].v < 0 || size_t(quad[k].v) >= nv) return false;
+        const float *v = &positions[3 * size_t(quad[k].v)];
+        p[k] = glm::vec3(v[0], v[1], v[2]);
+    }
+    glm::vec3 e02 = p[2] - p[0], e13 = p[3] - p[1];
+    return !(glm::dot(e02, e02) < glm::dot(e13, e13));
+}
+
+void loadMaterials(const std::vector<std::string> &libraries,
+                   const std::vector<std::string> &searchPaths,
+                   std::map<std::string, int> &materialMap,
+                   std::vector<tinyobj::material_t> &materials,
+                   std::vector<std::string> &resolved) {
+    for (const std::string &library : libraries) {
+        bool found = false;
+        for (const std::string &dir : searchPaths) {
+            std::string path = dir.empty() ? library : dir + "/" + library;
+            std::ifstream stream(path);
+            if (!stream) continue;
+
+            std::string warn, err;
+            tinyobj::LoadMtl(&materialMap, &materials, &stream, &warn, &err);
+            if (!err.empty()) std::cerr << "MTL ERROR: " << err << std::endl;
+            resolved.push_back(path);
+            found = true;
+            break;
+        }
+        if (!found) std::cerr << "Material library not found: " << library << std::endl;
+    }
+}
+
+// ====================== Welding ======================
+
+void weldGroup(const ObjData &data, const ObjGroup &group, ObjMesh &mesh) {
+    const size_t nv  = data.positions.size() / 3;
+    const size_t nvt = data.texcoords.size() / 2;
+    const size_t nvn = data.normals.size() / 3;
+
+    const ObjIndex *corners = data.corners.data() + group.firstTriangle * 3;
+    const size_t cornerCount = group.triangleCount * 3;
+    if (cornerCount == 0) return;
+
+    // Counting sort of the triangles by material, so each material's
+    // triangles form one contiguous index range (-1 and bad ids share a slot)
+    const int *materialIds = data.materialIds.data() + group.firstTriangle;
+    const int materialCount = static_cast<int>(data.materials.size());
+    auto materialSlot = [materialCount](int id) { return id >= 0 && id < materialCount ? id + 1 : 0; };
+
+    std::vector<uint32_t> offsets(size_t(materialCount) + 2, 0);
+    for (size_t t = 0; t < group.triangleCount; t++) {
+        offsets[materialSlot(materialIds[t]) + 1]++;
+    }
+    for (size_t slot = 0; slot <= size_t(materialCount); slot++) {
+        uint32_t count = offsets[slot + 1];
+        offsets[slot + 1] += offsets[slot];
+        if (count > 0) {
+            mesh.submeshes.push_back({ int(slot) - 1, offsets[slot] * 3, count * 3 });
+        }
+    }
+
+    std::vector<uint32_t> order(group.triangleCount);
+    for (size_t t = 0; t < group.triangleCount; t++) {
+        order[offsets[materialSlot(materialIds[t])]++] = uint32_t(t);
+    }
+
+    // The hash map is bucketed on the position index, which is already a
+    // perfect hash over the group's range of `v`; each bucket chains the few
+    // (vt, vn) variants that share a position. No per-node allocation, and
+    // the bucket table only spans the positions this group references.
+
+    // Out-of-range positions all share the -1 bucket
+    auto positionKey = [nv](int v) { return v >= 0 && size_t(v) < nv ? v : -1; };
+
+    int vMin = positionKey(corners[0].v), vMax = vMin;
+    for (size_t c = 1; c < cornerCount; c++) {
+        vMin = std::min(vMin, positionKey(corners[c].v));
+        vMax = std::max(vMax, positionKey(corners[c].v));
+    }
+
+    constexpr uint32_t NONE = UINT32_MAX;
+    std::vector<uint32_t> buckets(size_t(vMax - vMin) + 1, NONE);
+    std::vector<uint32_t> next;
+    std::vector<ObjIndex> unique;
+    next.reserve(buckets.size());
+    unique.reserve(buckets.size());
+    mesh.indices.resize(cornerCount);
+
+    for (size_t c = 0; c < cornerCount; c++) {
+        const ObjIndex &corner = corners[size_t(order[c / 3]) * 3 + c % 3];
+        uint32_t &bucket = buckets[size_t(positionKey(corner.v) - vMin)];
+
+        uint32_t vertex = bucket;
+        while (vertex != NONE && (unique[vertex].v != corner.v
+                                  || unique[vertex].vt != corner.vt
+                                  || unique[vertex].vn != corner.vn)) {
+            vertex = next[vertex];
+        }
+        if (vertex == NONE) {
+            vertex = uint32_t(unique.size());
+            unique.push_back(corner);
+            next.push_back(bucket);
+            bucket = vertex;
+        }
+        mesh.indices[c] = vertex;
+    }
+
+    mesh.vertices.assign(unique.size() * 8, 0.f);
+    bool missingNormals = false;
+
+    for (size_t i = 0; i < unique.size(); i++) {
+        const ObjIndex &index = unique[i];
+        float *out = &mesh.vertices[i * 8];
+
+        if (index.v >= 0 && size_t(index.v) < nv) {
+            std::copy_n(&data.positions[3 * size_t(index.v)], 3, out);
+        }
+        if (index.vn >= 0 && size_t(index.vn) < nvn) {
+            std::copy_n(&data.normals[3 * size_t(index.vn)], 3, out + 3);
+        } else {
+            missingNormals = true;
+        }
+        if (index.vt >= 0 && size_t(index.vt) < nvt) {
+            std::copy_n(&data.texcoords[2 * size_t(index.vt)], 2, out + 6);
+        }
+    }
+
+    if (!missingNormals) return;
+
+    // Smooth normals: the cross product's length weights each face by area
+    auto position = [&](uint32_t vertex) {
+        const float *p = &mesh.vertices[size_t(vertex) * 8];
+        return glm::vec3(p[0], p[1], p[2]);
+    };
+    auto hasNormal = [&](uint32_t vertex) {
+        int vn = unique[vertex].vn;
+        return vn >= 0 && size_t(vn) < nvn;
+    };
+
+    for (size_t t = 0; t < group.triangleCount; t++) {
+        const uint32_t *tri = &mesh.indices[t * 3];
+        glm::vec3 n = glm::cross(position(tri[1]) - position(tri[0]), position(tri[2]) - position(tri[0]));
+        for (int k = 0; k < 3; k++) {
+            if (hasNormal(tri[k])) continue;
+            float *out = &mesh.vertices[size_t(tri[k]) * 8 + 3];
+            out[0] += n.x;
+            out[1] += n.y;
+            out[2] += n.z;
+        }
+    }
+
+    for (uint32_t i = 0; i < unique.size(); i++) {
+        if (hasNormal(i)) continue;
+        float *out = &mesh.vertices[size_t(i) * 8 + 3];
+        glm::vec3 n(out[0], out[1], out[2]);
+        float length = glm::length(n);
+        n = length > 0.f ? n / length : glm::vec3(0.f, 1.f, 0.f);
+        out[0] = n.x;
+        out[1] = n.y;
+        out[2] = n.z;
+    }
+}
+
+} // namespace
+
+// ====================== Core API ======================
+
+bool ObjLoader::load(const std::string &filepath,
+                     const std::vector<std::string> &searchPaths,
+                     ObjData &out) {
+    QFile file(QString::fromStdString(filepath));
+    if (!file.open(QIODevice::ReadOnly)) {
+        std::cerr << "Failed to open OBJ: " << filepath << std::endl;
+        return false;
+    }
+
+    const qint64 size = file.size();
+    const char *bytes = size > 0 ? reinterpret_cast<const char*>(file.map(0, size)) : nullptr;
+    if (!bytes) {
+        out = ObjData();
+        return size == 0;
+    }
+    const char *end = bytes + size;
+
+    // ------------------------------------------------------------
+    // Split at line boundaries and parse each chunk independently
+    // ------------------------------------------------------------
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount = std::clamp(size_t(size) / MIN_CHUNK_BYTES, size_t(1), workers);
+
+    std::vector<const char*> bounds(chunkCount + 1, end);
+    bounds[0] = bytes;
+    for (size_t i = 1; i < chunkCount; i++) {
+        const char *p = std::max(bytes + size_t(size) * i / chunkCount, bounds[i - 1]);
+        const char *eol = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        bounds[i] = eol ? eol + 1 : end;
+    }
+
+    std::vector<Chunk> chunks(chunkCount);
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t last) {
+        for (size_t i = begin; i < last; i++) parseChunk(bounds[i], bounds[i + 1], chunks[i]);
+    });
+
+    // ------------------------------------------------------------
+    // Stitch: running offsets, materials and groups across chunks
+    // ------------------------------------------------------------
+    struct Offsets { size_t v = 0, vt = 0, vn = 0, triangle = 0; int material = -1; };
+    std::vector<Offsets> offsets(chunkCount + 1);
+
+    std::vector<std::string> libraries;
+    for (const Chunk &c : chunks) libraries.insert(libraries.end(), c.mtllibs.begin(), c.mtllibs.end());
+
+    std::map<std::string, int> materialMap;
+    ObjData data;
+    loadMaterials(libraries, searchPaths, materialMap, data.materials, data.materialLibraries);
+
+    // Chunk-local material names -> global ids (unknown names map to -1, as in tinyobj)
+    std::vector<std::vector<int>> materialIds(chunkCount);
+    for (size_t i = 0; i < chunkCount; i++) {
+        const Chunk &c = chunks[i];
+        for (const std::string &name : c.materialNames) {
+            auto it = materialMap.find(name);
+            materialIds[i].push_back(it != materialMap.end() ? it->second : -1);
+        }
+
+        Offsets &next = offsets[i + 1];
+        next.v        = offsets[i].v  + c.positions.size() / 3;
+        next.vt       = offsets[i].vt + c.texcoords.size() / 2;
+        next.vn       = offsets[i].vn + c.normals.size() / 3;
+        next.triangle = offsets[i].triangle + c.triangleCount;
+        next.material = c.endMaterial >= 0 ? materialIds[i][c.endMaterial] : offsets[i].material;
+    }
+
+    const Offsets &total = offsets[chunkCount];
+    data.positions.resize(total.v * 3);
+    data.texcoords.resize(total.vt * 2);
+    data.normals.resize(total.vn * 3);
+    data.corners.resize(total.triangle * 3);
+    data.materialIds.resize(total.triangle);
+
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t last) {
+        for (size_t i = begin; i < last; i++) {
+            const Chunk &c = chunks[i];
+            const Offsets &o = offsets[i];
+            std::copy(c.positions.begin(), c.positions.end(), data.positions.begin() + o.v * 3);
+            std::copy(c.texcoords.begin(), c.texcoords.end(), data.texcoords.begin() + o.vt * 2);
+            std::copy(c.normals.begin(), c.normals.end(), data.normals.begin() + o.vn * 3);
+        }
+    });
+
+    // Triangulate once every position is in place (quads look at both diagonals)
+    parallelFor(chunkCount, 1, [&](size_t begin, size_t last) {
+        for (size_t i = begin; i < last; i++) {
+            const Chunk &c = chunks[i];
+            const Offsets &o = offsets[i];
+
+            ObjIndex *out = data.corners.data() + o.triangle * 3;
+            int *ids = data.materialIds.data() + o.triangle;
+            size_t corner = 0;
+
+            for (size_t f = 0; f < c.polygonSizes.size(); f++) {
+                const size_t n = c.polygonSizes[f];
+                ObjIndex polygon[MAX_POLYGON];
+                for (size_t k = 0; k < n; k++, corner++) {
+                    polygon[k] = c.corners[corner];
+                    const uint8_t flags = c.relative[corner];
+                    if (flags & REL_V)  polygon[k].v  += int(o.v);
+                    if (flags & REL_VT) polygon[k].vt += int(o.vt);
+                    if (flags & REL_VN) polygon[k].vn += int(o.vn);
+                }
+
+                const int material = c.materials[f] < 0 ? o.material : materialIds[i][c.materials[f]];
+                for (size_t t = 0; t < n - 2; t++) *ids++ = material;
+
+                if (n == 4 && splitQuadAlong13(data.positions, polygon)) {
+                    // [0, 1, 3], [1, 2, 3]
+                    for (int k : { 0, 1, 3, 1, 2, 3 }) *out++ = polygon[k];
+                    continue;
+                }
+                // Fan: [0, k, k + 1]
+                for (size_t k = 1; k + 1 < n; k++) {
+                    *out++ = polygon[0];
+                    *out++ = polygon[k];
+                    *out++ = polygon[k + 1];
+                }
+            }
+        }
+    });
+
+    // Groups: an implicit unnamed group, then one per o/g; empty ones dropped
+    std::vector<std::pair<size_t, std::string>> starts{ { 0, std::string() } };
+    for (size_t i = 0; i < chunkCount; i++) {
+        for (const auto &[triangle, name] : chunks[i].groups) {
+            starts.emplace_back(offsets[i].triangle + triangle, name);
+        }
+    }
+    for (size_t i = 0; i < starts.size(); i++) {
+        size_t first = starts[i].first;
+        size_t last  = i + 1 < starts.size() ? starts[i + 1].first : total.triangle;
+        if (last > first) data.groups.push_back({ starts[i].second, first, last - first });
+    }
+
+    out = std::move(data);
+    return true;
+}
+
+std::vector<ObjMesh> ObjLoader::weld(const ObjData &data) {
+    std::vector<ObjMesh> meshes(data.groups.size());
+
+    parallelFor(data.groups.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t g = begin; g < end; g++) {
+            weldGroup(data, data.groups[g], meshes[g]);
+        }
+    });
+
+    return meshes;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "tiny_obj_loader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// One face corner; 0-based attribute indices, -1 when absent
+struct ObjIndex {
+    int v  = -1;
+    int vt = -1;
+    int vn = -1;
+};
+
+// A run of triangles started by an `o` or `g` statement
+struct ObjGroup {
+    std::string name;
+    size_t firstTriangle = 0;
+    size_t triangleCount = 0;
+};
+
+// A contiguous run of an ObjMesh's indices that share one material
+struct ObjSubmesh {
+    int material = -1;               // index into ObjData::materials (-1 = none)
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+// Welded, indexed geometry of one ObjGroup
+struct ObjMesh {
+    std::vector<float> vertices;     // pos(3) + normal(3) + uv(2), one per unique (v, vt, vn)
+    std::vector<uint32_t> indices;   // 3 per triangle, grouped by material
+    std::vector<ObjSubmesh> submeshes;   // ascending material, covering all indices
+};
+
+// Flattened contents of an OBJ file (polygons fan-triangulated)
+struct ObjData {
+    std::vector<float> positions;   // xyz
+    std::vector<float> normals;     // xyz
+    std::vector<float> texcoords;   // uv
+    std::vector<ObjIndex> corners;  // 3 per triangle
+    std::vector<int> materialIds;   // per triangle, index into materials (-1 = none)
+    std::vector<ObjGroup> groups;
+    std::vector<tinyobj::material_t> materials;
+    std::vector<std::string> materialLibraries;   // resolved path of each mtllib that was read
+};
+
+// ---------------------------------------------------------------------------
+// ObjLoader: parallel OBJ ingestion. The file is memory-mapped and split into
+// line-aligned chunks that are parsed on worker threads with a non-allocating
+// float parser; chunk results are then stitched together, resolving relative
+// indices, `usemtl` state and groups that span chunk boundaries. Material
+// libraries are small and still go through tinyobj::LoadMtl.
+// ---------------------------------------------------------------------------
+
+class ObjLoader {
+public:
+    // @param filepath     The .obj file to load.
+    // @param searchPaths  Directories tried in order for `mtllib` files.
+    // @param out          On success, the parsed file.
+    static bool load(const std::string &filepath,
+                     const std::vector<std::string> &searchPaths,
+                     ObjData &out);
+
+    // Welds every group's corners into unique vertices through a hash map on
+    // (v, vt, vn), one group per worker. Triangles are reordered so that each
+    // material is one submesh. Corners without a normal get the
+    // area-weighted average of their faces' normals; missing uvs are zero.
+    static std::vector<ObjMesh> weld(const ObjData &data);
+};
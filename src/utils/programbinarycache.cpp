@@ -0,0 +1,161 @@
+#include "programbinarycache.h"
+
+#include <QStandardPaths>
+#include <QString>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char     MAGIC[8] = { 'G', 'L', 'P', 'R', 'O', 'G', 'B', 'N' };
+constexpr uint32_t VERSION  = 1;
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t format;        // driver-specific binary format enum
+    uint64_t key;           // guards against file name collisions
+    uint64_t length;        // binary bytes following the header
+};
+
+// FNV-1a: stable across runs and standard libraries, unlike std::hash
+uint64_t fnv1a(const std::string &text, uint64_t hash = 0xcbf29ce484222325ull) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+std::string driverString(GLenum name) {
+    const GLubyte *value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+fs::path cachePath(uint64_t key) {
+    std::error_code ec;
+    QString location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    fs::path root = location.isEmpty() ? fs::temp_directory_path(ec) : fs::path(location.toStdString());
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.glbin", static_cast<unsigned long long>(key));
+    return root / "shaders" / name;
+}
+
+bool binariesSupported() {
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+GLuint restore(uint64_t key) {
+    if (!binariesSupported()) return 0;
+
+    const fs::path path = cachePath(key);
+    std::ifstream file(path, std::ios::binary);
+    if (!file) return 0;
+
+    Header header;
+    file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+    std::error_code ec;
+    const uintmax_t size = fs::file_size(path, ec);
+    if (!file
+        || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+        || header.version != VERSION
+        || header.key != key
+        || ec || size != sizeof(Header) + header.length) {
+        return 0;
+    }
+
+    std::vector<char> binary(header.length);
+    file.read(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!file) return 0;
+
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) {
+        // Same key but the driver no longer accepts the format; rebuild it
+        std::cout << "Discarding stale program binary: " << path.string() << std::endl;
+        glDeleteProgram(program);
+        file.close();
+        fs::remove(path, ec);
+        return 0;
+    }
+
+    return program;
+}
+
+} // namespace
+
+// ====================== Core API ======================
+
+uint64_t ProgramBinaryCache::key(const std::string &sources) {
+    std::string driver = driverString(GL_VENDOR) + '\n' + driverString(GL_RENDERER) + '\n'
+                       + driverString(GL_VERSION) + '\n';
+    return fnv1a(sources, fnv1a(driver));
+}
+
+GLuint ProgramBinaryCache::load(uint64_t key) {
+    GLuint program = restore(key);
+    (program ? s_hits : s_misses)++;
+    return program;
+}
+
+void ProgramBinaryCache::store(uint64_t key, GLuint program) {
+    if (!binariesSupported()) return;
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+    if (length <= 0) return;
+
+    const fs::path path = cachePath(key);
+    fs::path temp = path;
+    temp += ".tmp";
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to write program binary: " << temp.string() << std::endl;
+        return;
+    }
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.format  = format;
+    header.key     = key;
+    header.length  = static_cast<uint64_t>(length);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(binary.data(), length);
+    file.close();
+
+    if (!file) {
+        std::cerr << "Failed to write program binary: " << temp.string() << std::endl;
+        fs::remove(temp, ec);
+        return;
+    }
+
+    fs::rename(temp, path, ec);
+    if (ec) {
+        std::cerr << "Failed to replace program binary: " << path.string() << " (" << ec.message() << ")" << std::endl;
+        fs::remove(temp, ec);
+    }
+}
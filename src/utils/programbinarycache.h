@@ -0,0 +1,44 @@
+#pragma once
+
+// Defined before including GLEW to suppress deprecation messages on macOS
+#ifdef __APPLE__
+#define GL_SILENCE_DEPRECATION
+#endif
+#include <GL/glew.h>
+
+#include <cstdint>
+#include <string>
+
+// ---------------------------------------------------------------------------
+// ProgramBinaryCache: linked programs saved with glGetProgramBinary in the
+// user cache directory and restored with glProgramBinary on the next run.
+// The key hashes the final source of every stage (includes expanded and
+// #defines injected, so each permutation has its own entry) together with
+// the driver's vendor, renderer and version strings; a driver update or a
+// shader edit simply misses. Binaries the driver rejects are deleted and the
+// caller compiles from source as before.
+// ---------------------------------------------------------------------------
+
+class ProgramBinaryCache {
+public:
+    // Key for a program built from `sources`, the concatenated stage types
+    // and source text. Needs a current context for the driver strings.
+    static uint64_t key(const std::string &sources);
+
+    // A linked program restored from the binary stored under key, or 0 on a
+    // miss, a stale or truncated file, or a binary the driver refuses
+    static GLuint load(uint64_t key);
+
+    // Saves a linked program's binary under key. The program should have been
+    // linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. Failures are
+    // reported and otherwise ignored.
+    static void store(uint64_t key, GLuint program);
+
+    // Programs restored from disk / compiled from source since startup
+    static int hits()   { return s_hits; }
+    static int misses() { return s_misses; }
+
+private:
+    static inline int s_hits = 0;
+    static inline int s_misses = 0;
+};
@@ -0,0 +1,70 @@
+#include "programcache.h"
+
+#include <algorithm>
+
+std::string ProgramCache::makeKey(const char *vertexPath, const char *fragmentPath, ShaderDefines &defines,
+                                  const char *geometryPath) {
+    std::sort(defines.begin(), defines.end());
+
+    std::string key = std::string(vertexPath) + '\n' + (geometryPath ? geometryPath : "") + '\n' + fragmentPath;
+    for (const std::string &define : defines) key += '\n' + define;
+    return key;
+}
+
+void ProgramCache::start(const std::string &key, const char *vertexPath, const char *fragmentPath,
+                         const ShaderDefines &defines, const char *geometryPath) {
+    if (m_programs.count(key) || m_pending.count(key)) return;
+
+    std::vector<ShaderSource> stages;
+    stages.push_back({ GL_VERTEX_SHADER, ShaderLoader::loadSource(vertexPath, defines) });
+    if (geometryPath) stages.push_back({ GL_GEOMETRY_SHADER, ShaderLoader::loadSource(geometryPath, defines) });
+    stages.push_back({ GL_FRAGMENT_SHADER, ShaderLoader::loadSource(fragmentPath, defines) });
+
+    m_pending.emplace(key, ShaderLoader::beginShaderProgram(stages));
+}
+
+const ProgramCache::Program &ProgramCache::finish(const std::string &key) {
+    auto it = m_pending.find(key);
+    PendingProgram pending = std::move(it->second);
+    m_pending.erase(it);
+
+    Program program;
+    program.id = ShaderLoader::finishShaderProgram(pending, &program.reflection);
+    return m_programs.emplace(key, std::move(program)).first->second;
+}
+
+void ProgramCache::request(const char *vertexPath, const char *fragmentPath, ShaderDefines defines,
+                           const char *geometryPath) {
+    std::string key = makeKey(vertexPath, fragmentPath, defines, geometryPath);
+    start(key, vertexPath, fragmentPath, defines, geometryPath);
+}
+
+bool ProgramCache::ready(const char *vertexPath, const char *fragmentPath, ShaderDefines defines,
+                         const char *geometryPath) {
+    std::string key = makeKey(vertexPath, fragmentPath, defines, geometryPath);
+    if (m_programs.count(key)) return true;
+
+    start(key, vertexPath, fragmentPath, defines, geometryPath);
+    if (!ShaderLoader::isComplete(m_pending.at(key))) return false;
+
+    finish(key);
+    return true;
+}
+
+const ProgramCache::Program &ProgramCache::get(const char *vertexPath, const char *fragmentPath,
+                                               ShaderDefines defines, const char *geometryPath) {
+    std::string key = makeKey(vertexPath, fragmentPath, defines, geometryPath);
+
+    auto it = m_programs.find(key);
+    if (it != m_programs.end()) return it->second;
+
+    start(key, vertexPath, fragmentPath, defines, geometryPath);
+    return finish(key);
+}
+
+void ProgramCache::clear() {
+    for (auto &[key, program] : m_programs) glDeleteProgram(program.id);
+    for (auto &[key, pending] : m_pending) ShaderLoader::discard(pending);
+    m_programs.clear();
+    m_pending.clear();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "shaderloader.h"
+
+#include <string>
+#include <unordered_map>
+
+// ---------------------------------------------------------------------------
+// ProgramCache: linked programs keyed by their stage files and #define set.
+// Each permutation is compiled through ShaderLoader the first time it is
+// requested and kept, with its reflection, until clear(). Define order does
+// not matter.
+//
+// request() only hands the sources to the driver; ready() polls for the
+// result without blocking, and get() waits for it if it is still in flight.
+// An optional geometry stage goes between the vertex and fragment shaders.
+// ---------------------------------------------------------------------------
+
+class ProgramCache {
+public:
+    struct Program {
+        GLuint id = 0;
+        ShaderReflection reflection;
+    };
+
+    // Starts compiling a permutation; no-op if it is already known
+    void request(const char *vertexPath, const char *fragmentPath, ShaderDefines defines = {},
+                 const char *geometryPath = nullptr);
+
+    // Requests the permutation if needed and reports whether get() would
+    // return without waiting. Throws like get() once the driver is done.
+    bool ready(const char *vertexPath, const char *fragmentPath, ShaderDefines defines = {},
+               const char *geometryPath = nullptr);
+
+    // Throws std::runtime_error (from ShaderLoader) if a new permutation
+    // fails to compile or link
+    const Program &get(const char *vertexPath, const char *fragmentPath, ShaderDefines defines = {},
+                       const char *geometryPath = nullptr);
+
+    size_t size() const { return m_programs.size(); }
+
+    // Deletes every program, finished or not; needs the owning context current
+    void clear();
+
+private:
+    std::unordered_map<std::string, Program> m_programs;
+    std::unordered_map<std::string, PendingProgram> m_pending;
+
+    // Sorts defines in place
+    static std::string makeKey(const char *vertexPath, const char *fragmentPath, ShaderDefines &defines,
+                               const char *geometryPath);
+    void start(const std::string &key, const char *vertexPath, const char *fragmentPath,
+               const ShaderDefines &defines, const char *geometryPath);
+    const Program &finish(const std::string &key);
+};
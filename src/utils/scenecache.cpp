@@ -0,0 +1,375 @@
+#include "scenecache.h"
+
+#include <QFile>
+#include <QStandardPaths>
+#include <QString>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr char     MAGIC[8] = { 'S', 'C', 'N', 'C', 'A', 'C', 'H', 'E' };
+constexpr uint32_t VERSION  = 4;
+constexpr size_t   PAYLOAD_ALIGNMENT = 16;   // array payloads start on this boundary
+
+struct Header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t sourceCount;
+    uint64_t fileSize;      // guards against truncated writes
+    // Structs copied byte-for-byte; a layout change invalidates the snapshot
+    uint32_t globalBytes;
+    uint32_t cameraBytes;
+    uint32_t lightBytes;
+    uint32_t pad;
+};
+
+struct SourceStamp {
+    std::string path;
+    int64_t size  = 0;
+    int64_t mtime = 0;
+};
+
+// ====================== Keys ======================
+
+std::string canonicalPath(const std::string &path) {
+    std::error_code ec;
+    fs::path absolute = fs::absolute(path, ec);
+    return ec ? path : absolute.lexically_normal().string();
+}
+
+bool stamp(const std::string &path, SourceStamp &out) {
+    std::error_code ec;
+    auto size = fs::file_size(path, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(path, ec);
+    if (ec) return false;
+
+    out = { path, static_cast<int64_t>(size), static_cast<int64_t>(mtime.time_since_epoch().count()) };
+    return true;
+}
+
+fs::path cachePath(const std::string &scenePath) {
+    std::error_code ec;
+    QString location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    fs::path root = location.isEmpty() ? fs::temp_directory_path(ec) : fs::path(location.toStdString());
+
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.scache",
+                  static_cast<unsigned long long>(std::hash<std::string>{}(scenePath)));
+    return root / "scenes" / name;
+}
+
+// ====================== Serialization ======================
+
+class Writer {
+public:
+    explicit Writer(std::ofstream &out) : m_out(out) {}
+
+    template <typename T>
+    void pod(const T &value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        bytes(&value, sizeof(T));
+    }
+
+    void string(const std::string &s) {
+        pod(static_cast<uint32_t>(s.size()));
+        bytes(s.data(), s.size());
+    }
+
+    template <typename T>
+    void array(std::span<const T> data) {
+        pod(static_cast<uint64_t>(data.size()));
+        static const char zeros[PAYLOAD_ALIGNMENT] = {};
+        bytes(zeros, (PAYLOAD_ALIGNMENT - m_offset % PAYLOAD_ALIGNMENT) % PAYLOAD_ALIGNMENT);
+        bytes(data.data(), data.size_bytes());
+    }
+
+    uint64_t offset() const { return m_offset; }
+
+private:
+    std::ofstream &m_out;
+    uint64_t m_offset = 0;
+
+    void bytes(const void *data, size_t size) {
+        m_out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        m_offset += size;
+    }
+};
+
+// Bounds-checked cursor over the mapped file; any overrun latches failure
+class Reader {
+public:
+    Reader(const uchar *data, size_t size) : m_data(data), m_size(size) {}
+
+    template <typename T>
+    bool pod(T &out) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        if (!take(sizeof(T))) return false;
+        std::memcpy(&out, m_data + m_pos - sizeof(T), sizeof(T));
+        return true;
+    }
+
+    bool string(std::string &out) {
+        uint32_t size = 0;
+        if (!pod(size) || !take(size)) return false;
+        out.assign(reinterpret_cast<const char*>(m_data + m_pos - size), size);
+        return true;
+    }
+
+    // Returns a view into the mapping rather than a copy
+    template <typename T>
+    bool array(std::span<const T> &out) {
+        uint64_t count = 0;
+        if (!pod(count)) return false;
+        if (!take((PAYLOAD_ALIGNMENT - m_pos % PAYLOAD_ALIGNMENT) % PAYLOAD_ALIGNMENT)) return false;
+        if (count > (m_size - m_pos) / sizeof(T)) return m_ok = false;
+        out = std::span<const T>(reinterpret_cast<const T*>(m_data + m_pos), count);
+        m_pos += count * sizeof(T);
+        return true;
+    }
+
+    bool ok() const { return m_ok; }
+
+private:
+    const uchar *m_data;
+    size_t m_size;
+    size_t m_pos = 0;
+    bool m_ok = true;
+
+    bool take(size_t size) {
+        if (!m_ok || m_size - m_pos < size) return m_ok = false;
+        m_pos += size;
+        return true;
+    }
+};
+
+void writeFileMap(Writer &out, const SceneFileMap &map) {
+    out.pod(map.isUsed);
+    out.string(map.filename);
+    out.pod(map.repeatU);
+    out.pod(map.repeatV);
+}
+
+bool readFileMap(Reader &in, SceneFileMap &map) {
+    return in.pod(map.isUsed) && in.string(map.filename) && in.pod(map.repeatU) && in.pod(map.repeatV);
+}
+
+void writeMaterial(Writer &out, const SceneMaterial &m) {
+    out.pod(m.cAmbient);
+    out.pod(m.cDiffuse);
+    out.pod(m.cSpecular);
+    out.pod(m.shininess);
+    out.pod(m.cReflective);
+    out.pod(m.cTransparent);
+    out.pod(m.ior);
+    writeFileMap(out, m.textureMap);
+    out.pod(m.blend);
+    out.pod(m.cEmissive);
+    writeFileMap(out, m.bumpMap);
+}
+
+bool readMaterial(Reader &in, SceneMaterial &m) {
+    return in.pod(m.cAmbient) && in.pod(m.cDiffuse) && in.pod(m.cSpecular) && in.pod(m.shininess)
+        && in.pod(m.cReflective) && in.pod(m.cTransparent) && in.pod(m.ior)
+        && readFileMap(in, m.textureMap) && in.pod(m.blend)
+        && in.pod(m.cEmissive) && readFileMap(in, m.bumpMap);
+}
+
+} // namespace
+
+// ====================== Core API ======================
+
+bool SceneCache::load(const std::string &filepath, RenderData &renderData) {
+    const std::string scenePath = canonicalPath(filepath);
+    const fs::path path = cachePath(scenePath);
+
+    auto file = std::make_shared<QFile>(QString::fromStdString(path.string()));
+    if (!file->open(QIODevice::ReadOnly)) return false;
+
+    const qint64 size = file->size();
+    const uchar *bytes = size > 0 ? file->map(0, size) : nullptr;
+    if (!bytes) return false;
+
+    Reader in(bytes, static_cast<size_t>(size));
+
+    Header header;
+    if (!in.pod(header)
+        || std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+        || header.version != VERSION
+        || header.fileSize != static_cast<uint64_t>(size)
+        || header.globalBytes != sizeof(SceneGlobalData)
+        || header.cameraBytes != sizeof(SceneCameraData)
+        || header.lightBytes  != sizeof(SceneLightData)
+        || header.sourceCount == 0) {
+        return false;
+    }
+
+    // Every source must still have the size and mtime it had when written
+    for (uint32_t i = 0; i < header.sourceCount; i++) {
+        SourceStamp recorded, current;
+        if (!in.string(recorded.path) || !in.pod(recorded.size) || !in.pod(recorded.mtime)) return false;
+        if (i == 0 && recorded.path != scenePath) return false;   // hash collision
+
+        if (!stamp(recorded.path, current)
+            || current.size != recorded.size
+            || current.mtime != recorded.mtime) {
+            std::cout << "Scene cache is stale (" << recorded.path << " changed)" << std::endl;
+            return false;
+        }
+    }
+
+    RenderData data;
+    in.pod(data.globalData);
+    in.pod(data.cameraData);
+
+    uint32_t lightCount = 0;
+    in.pod(lightCount);
+    for (uint32_t i = 0; i < lightCount && in.ok(); i++) {
+        SceneLightData light;
+        in.pod(light);
+        data.lights.push_back(light);
+    }
+
+    uint32_t shapeCount = 0;
+    in.pod(shapeCount);
+    for (uint32_t i = 0; i < shapeCount && in.ok(); i++) {
+        RenderShapeData shape;
+        int32_t type = 0;
+        in.pod(type);
+        shape.primitive.type = static_cast<PrimitiveType>(type);
+        readMaterial(in, shape.primitive.material);
+        in.string(shape.primitive.meshfile);
+        in.pod(shape.ctm);
+        in.array(shape.triView);
+        in.array(shape.triIndexView);
+
+        uint32_t submeshCount = 0;
+        in.pod(submeshCount);
+        for (uint32_t j = 0; j < submeshCount && in.ok(); j++) {
+            RenderSubmesh submesh;
+            in.pod(submesh.firstIndex);
+            in.pod(submesh.indexCount);
+            readMaterial(in, submesh.material);
+            shape.submeshes.push_back(std::move(submesh));
+        }
+        data.shapes.push_back(std::move(shape));
+    }
+
+    if (!in.ok()) {
+        std::cerr << "Scene cache is corrupt: " << path.string() << std::endl;
+        return false;
+    }
+
+    data.storage = file;   // unmapped when the last RenderData copy goes away
+    renderData = std::move(data);
+
+    std::cout << "Loaded scene from cache: " << path.string() << std::endl;
+    return true;
+}
+
+void SceneCache::store(const std::string &filepath, const RenderData &renderData) {
+    const std::string scenePath = canonicalPath(filepath);
+
+    // Key: the scene file first, then each OBJ it pulls in and the
+    // material libraries those read
+    std::vector<SourceStamp> sources(1);
+    if (!stamp(scenePath, sources[0])) return;
+
+    std::set<std::string> dependencies;
+    for (const RenderShapeData &shape : renderData.shapes) {
+        if (shape.primitive.type == PrimitiveType::PRIMITIVE_MESH) {
+            dependencies.insert(canonicalPath(shape.primitive.meshfile));
+        }
+    }
+    for (const std::string &library : renderData.materialLibraries) {
+        dependencies.insert(canonicalPath(library));
+    }
+    for (const std::string &dependency : dependencies) {
+        SourceStamp source;
+        if (!stamp(dependency, source)) return;   // cannot be validated later
+        sources.push_back(source);
+    }
+
+    const fs::path path = cachePath(scenePath);
+    fs::path temp = path;
+    temp += ".tmp";
+
+    std::error_code ec;
+    fs::create_directories(path.parent_path(), ec);
+
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        std::cerr << "Failed to write scene cache: " << temp.string() << std::endl;
+        return;
+    }
+
+    Writer out(file);
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version     = VERSION;
+    header.sourceCount = static_cast<uint32_t>(sources.size());
+    header.globalBytes = sizeof(SceneGlobalData);
+    header.cameraBytes = sizeof(SceneCameraData);
+    header.lightBytes  = sizeof(SceneLightData);
+    out.pod(header);
+
+    for (const SourceStamp &source : sources) {
+        out.string(source.path);
+        out.pod(source.size);
+        out.pod(source.mtime);
+    }
+
+    out.pod(renderData.globalData);
+    out.pod(renderData.cameraData);
+
+    out.pod(static_cast<uint32_t>(renderData.lights.size()));
+    for (const SceneLightData &light : renderData.lights) {
+        out.pod(light);
+    }
+
+    out.pod(static_cast<uint32_t>(renderData.shapes.size()));
+    for (const RenderShapeData &shape : renderData.shapes) {
+        out.pod(static_cast<int32_t>(shape.primitive.type));
+        writeMaterial(out, shape.primitive.material);
+        out.string(shape.primitive.meshfile);
+        out.pod(shape.ctm);
+        out.array(shape.triangles());
+        out.array(shape.indices());
+
+        out.pod(static_cast<uint32_t>(shape.submeshes.size()));
+        for (const RenderSubmesh &submesh : shape.submeshes) {
+            out.pod(submesh.firstIndex);
+            out.pod(submesh.indexCount);
+            writeMaterial(out, submesh.material);
+        }
+    }
+
+    // Patch the final size in so a torn write never validates
+    header.fileSize = out.offset();
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.close();
+
+    if (!file) {
+        std::cerr << "Failed to write scene cache: " << temp.string() << std::endl;
+        fs::remove(temp, ec);
+        return;
+    }
+
+    fs::rename(temp, path, ec);
+    if (ec) {
+        std::cerr << "Failed to replace scene cache: " << path.string() << " (" << ec.message() << ")" << std::endl;
+        fs::remove(temp, ec);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "sceneparser.h"
+
+#include <string>
+
+// ---------------------------------------------------------------------------
+// SceneCache: versioned binary snapshot of a flattened RenderData, stored in
+// the user cache directory and keyed by the path, size and mtime of the
+// scene file, every OBJ it references and every material library those
+// read. On a hit the snapshot is memory-mapped and triangle data is exposed
+// as views into the mapping, so it can go to the GPU without being copied
+// or parsed.
+// ---------------------------------------------------------------------------
+
+class SceneCache {
+public:
+    // Fills renderData from an up-to-date snapshot of filepath.
+    // Returns false (leaving renderData untouched) on a miss or a stale,
+    // truncated or incompatible snapshot.
+    static bool load(const std::string &filepath, RenderData &renderData);
+
+    // Writes a snapshot of renderData for filepath. Failures are reported
+    // and otherwise ignored; the next load simply re-parses.
+    static void store(const std::string &filepath, const RenderData &renderData);
+};
@@ -1,114 +1,92 @@
-#define TINYOBJLOADER_IMPLEMENTATION
-
-#include "tiny_obj_loader.h"
 #include <QString>
 #include <QImage>
 
 #include "sceneparser.h"
 #include "scenefilereader.h"
+#include "scenecache.h"
+#include "objloader.h"
 #include <glm/gtx/transform.hpp>
 
 #include <chrono>
+#include <filesystem>
 #include <iostream>
 
-void insertVec3(std::vector<GLfloat> &data, glm::vec3 v)
-{
-    data.push_back(v.x);
-    data.push_back(v.y);
-    data.push_back(v.z);
-}
-
-void insertVec2(std::vector<GLfloat> &data, glm::vec2 v)
-{
-    data.push_back(v.x);
-    data.push_back(v.y);
-}
-
-void load_triangles(const tinyobj::shape_t &obj, std::vector<glm::vec3> &vertices, std::vector<glm::vec3> &normals, std::vector<glm::vec2> &uvs, std::vector<SceneMaterial> &materials, std::vector<RenderShapeData> &shapes, ScenePrimitive *shape, glm::mat4 ptm)
+void load_triangles(ObjMesh &mesh, const std::vector<SceneMaterial> &materials, std::vector<RenderShapeData> &shapes, ScenePrimitive *shape, glm::mat4 ptm)
 {
-    const std::vector<tinyobj::index_t> &indices = obj.mesh.indices;
-    const std::vector<int> &mat_ids = obj.mesh.material_ids;
-
-    std::cout << "Loading " << mat_ids.size() << " triangles..." << std::endl;
-
-    std::vector<GLfloat> tris;
-    for (size_t face_ind = 0; face_ind < mat_ids.size(); face_ind++)
-    {
-        insertVec3(tris, vertices[indices[3 * face_ind].vertex_index]);
-        insertVec3(tris, normals[indices[3 * face_ind].normal_index]);
-        insertVec2(tris, uvs[indices[3 * face_ind].texcoord_index]);
-        insertVec3(tris, vertices[indices[3 * face_ind + 1].vertex_index]);
-        insertVec3(tris, normals[indices[3 * face_ind + 1].normal_index]);
-        insertVec2(tris, uvs[indices[3 * face_ind + 1].texcoord_index]);
-        insertVec3(tris, vertices[indices[3 * face_ind + 2].vertex_index]);
-        insertVec3(tris, normals[indices[3 * face_ind + 2].normal_index]);
-        insertVec2(tris, uvs[indices[3 * face_ind + 2].texcoord_index]);
+    std::cout << "Loading " << mesh.indices.size() / 3 << " triangles ("
+              << mesh.vertices.size() / 8 << " unique vertices, "
+              << mesh.submeshes.size() << " materials)..." << std::endl;
+
+    RenderShapeData shapeData(*shape, ptm, std::move(mesh.vertices));
+    shapeData.triIndices = std::move(mesh.indices);
+
+    // Faces without a usemtl keep the scene file's material
+    for (const ObjSubmesh &sub : mesh.submeshes) {
+        RenderSubmesh submesh;
+        submesh.firstIndex = sub.firstIndex;
+        submesh.indexCount = sub.indexCount;
+        submesh.material   = sub.material >= 0 ? materials[sub.material] : shape->material;
+        shapeData.submeshes.push_back(std::move(submesh));
+    }
+    if (!shapeData.submeshes.empty()) {
+        shapeData.primitive.material = shapeData.submeshes.front().material;
     }
-    shape->material = materials[obj.mesh.material_ids[0]];
-    shapes.push_back(RenderShapeData(*shape, ptm, tris));
+
+    shapes.push_back(std::move(shapeData));
 }
 
 
-void parseMesh(std::vector<RenderShapeData>& shapes, ScenePrimitive* shape, glm::mat4 ptm) {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> objs;
-    std::vector<tinyobj::material_t> objmaterials;
-    std::string err, warn;
+void parseMesh(std::vector<RenderShapeData>& shapes, std::vector<std::string>& materialLibraries,
+               ScenePrimitive* shape, glm::mat4 ptm) {
+    auto start = std::chrono::steady_clock::now();
 
+    // Material libraries are looked up next to the OBJ, then in the legacy build dir
     std::string meshfile_dir = "/Users/brianxu/VSCode/cs1230/scene_rasterization/build";
+    std::vector<std::string> search_paths = {
+        std::filesystem::path(shape->meshfile).parent_path().string(),
+        meshfile_dir
+    };
+
+    ObjData obj;
+    if (!ObjLoader::load(shape->meshfile, search_paths, obj)) {
+        return;
+    }
 
-    bool success = tinyobj::LoadObj(&attrib, &objs, &objmaterials, &warn, &err,
-        shape->meshfile.c_str(), //model to load
-        meshfile_dir.c_str(), //directory to search for materials
-        true); //enable triangulation
+    materialLibraries.insert(materialLibraries.end(), obj.materialLibraries.begin(), obj.materialLibraries.end());
 
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
-    std::vector<glm::vec2> uvs;
     std::vector<SceneMaterial> materials;
 
-    for (size_t vec_start = 0; vec_start < attrib.vertices.size(); vec_start += 3) {
-        vertices.emplace_back(
-            attrib.vertices[vec_start],
-            attrib.vertices[vec_start + 1],
-            attrib.vertices[vec_start + 2]);
-    }
-
-    for (size_t norm_start = 0; norm_start < attrib.normals.size(); norm_start += 3) {
-        normals.emplace_back(
-            attrib.normals[norm_start],
-            attrib.normals[norm_start + 1],
-            attrib.normals[norm_start + 2]);
-    }
-    
-    for (size_t uv_start = 0; uv_start < attrib.texcoords.size(); uv_start += 2) {
-        uvs.emplace_back(
-            attrib.texcoords[uv_start],
-            attrib.texcoords[uv_start + 1]);
-    }
-
-    for (size_t mat_start = 0; mat_start < objmaterials.size(); mat_start += 1) {
-        tinyobj::material_t mat = objmaterials[mat_start];
+    for (size_t mat_start = 0; mat_start < obj.materials.size(); mat_start += 1) {
+        const tinyobj::material_t &mat = obj.materials[mat_start];
         glm::vec4 ambient(mat.ambient[0], mat.ambient[1], mat.ambient[2], 1.0f);
         glm::vec4 diffuse(mat.diffuse[0], mat.diffuse[1], mat.diffuse[2], 1.0f);
         glm::vec4 specular(mat.specular[0], mat.specular[1], mat.specular[2], 1.0f);
+        // Submesh materials come from the MTL alone, not the JSON shape
         SceneMaterial sceneMat;
+        sceneMat.clear();
         sceneMat.cAmbient = ambient;
         sceneMat.cDiffuse = diffuse;
         sceneMat.cSpecular = specular;
+        sceneMat.shininess = mat.shininess;
         if (!mat.diffuse_texname.empty()) {
             std::string texture_path = ":/resources/textures/" + mat.diffuse_texname;
             QImage texture = QImage(QString(texture_path.c_str()));
             texture = texture.convertToFormat(QImage::Format_RGBA8888).mirrored();
             sceneMat.textureMap.isUsed = true;
+            sceneMat.textureMap.filename = texture_path;
             sceneMat.textureMap.texture = texture;
         }
         materials.push_back(sceneMat);
     }
 
-    for(auto obj = objs.begin(); obj < objs.end(); ++obj) {
-        load_triangles(*obj, vertices, normals, uvs, materials, shapes, shape, ptm);
+    std::vector<ObjMesh> meshes = ObjLoader::weld(obj);
+    for (size_t g = 0; g < meshes.size(); g++) {
+        load_triangles(meshes[g], materials, shapes, shape, ptm);
     }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    std::cout << "Loaded " << shape->meshfile << " (" << obj.materialIds.size() << " triangles) in "
+              << elapsed.count() << " ms" << std::endl;
 }
 
 void parseAux(SceneNode* node, glm::mat4 ctm, RenderData &renderData) {
@@ -139,7 +117,7 @@ void parseAux(SceneNode* node, glm::mat4 ctm, RenderData &renderData) {
 
     for (ScenePrimitive* shape : node->primitives) {
         if (shape->type == PrimitiveType::PRIMITIVE_MESH) {
-            parseMesh(renderData.shapes, shape, ctm);
+            parseMesh(renderData.shapes, renderData.materialLibraries, shape, ctm);
         }
         else {
             RenderShapeData shapeData;
@@ -168,6 +146,10 @@ void parseAux(SceneNode* node, glm::mat4 ctm, RenderData &renderData) {
 }
 
 bool SceneParser::parse(std::string filepath, RenderData &renderData) {
+    if (SceneCache::load(filepath, renderData)) {
+        return true;
+    }
+
     ScenefileReader fileReader = ScenefileReader(filepath);
     bool success = fileReader.readJSON();
     if (!success) {
@@ -179,9 +161,13 @@ bool SceneParser::parse(std::string filepath, RenderData &renderData) {
 
     renderData.shapes.clear();
     renderData.lights.clear();
+    renderData.materialLibraries.clear();
+    renderData.storage.reset();
     SceneNode* rootNode = fileReader.getRootNode();
     glm::mat4 ctm = glm::mat4(1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1);
     parseAux(rootNode, ctm, renderData);
 
+    SceneCache::store(filepath, renderData);
+
     return true;
 }
@@ -2,14 +2,36 @@
 
 #include "scenedata.h"
 #include <GL/glew.h>
+#include <memory>
+#include <span>
 #include <vector>
 #include <string>
 
+// A contiguous run of a mesh's indices drawn with one material
+struct RenderSubmesh {
+    GLuint firstIndex = 0;
+    GLuint indexCount = 0;
+    SceneMaterial material;
+    int texture = -1; // handle into Realtime's TextureRegistry (-1 = untextured)
+};
+
 // Struct which contains data for a single primitive, to be used for rendering
 struct RenderShapeData {
     ScenePrimitive primitive;
     glm::mat4 ctm; // the cumulative transformation matrix
     std::vector<GLfloat> triData;
+    int texture = -1; // handle into Realtime's TextureRegistry (-1 = untextured)
+    std::span<const GLfloat> triView; // used instead of triData when loaded from the scene cache
+    std::vector<GLuint> triIndices;      // 3 per triangle into triData; empty for a triangle soup
+    std::span<const GLuint> triIndexView; // used instead of triIndices when loaded from the scene cache
+    std::vector<RenderSubmesh> submeshes; // OBJ meshes, one per material; empty = all indices, primitive.material
+
+    std::span<const GLfloat> triangles() const {
+        return triView.empty() ? std::span<const GLfloat>(triData) : triView;
+    }
+    std::span<const GLuint> indices() const {
+        return triIndexView.empty() ? std::span<const GLuint>(triIndices) : triIndexView;
+    }
 };
 
 // Struct which contains all the data needed to render a scene
@@ -19,11 +41,15 @@ struct RenderData {
 
     std::vector<SceneLightData> lights;
     std::vector<RenderShapeData> shapes;
+    std::vector<std::string> materialLibraries; // mtllib files the OBJ meshes read (filled by the parser)
+
+    std::shared_ptr<const void> storage; // keeps the memory-mapped cache behind any triView/triIndexView alive
 };
 
 class SceneParser {
 public:
     // Parse the scene and store the results in renderData.
+    // Reuses the binary SceneCache snapshot when its source files are unchanged.
     // @param filepath    The path of the scene file to load.
     // @param renderData  On return, this will contain the metadata of the loaded scene.
     // @return            A boolean value indicating whether the parse was successful.
@@ -5,23 +5,217 @@
 #define GL_SILENCE_DEPRECATION
 #endif
 #include <GL/glew.h>
+#include "programbinarycache.h"
 #include <QFile>
+#include <QFileInfo>
 #include <QTextStream>
 #include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Active uniforms of a linked program, enumerated once at link time so the
+// render passes can resolve their integer handles up front instead of calling
+// glGetUniformLocation (and building name strings) every draw.
+class ShaderReflection{
+public:
+    void build(GLuint programID){
+        m_program = programID;
+        m_uniforms.clear();
+        m_blocks.clear();
+
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+        std::string name(maxLength, '\0');
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(programID, i, maxLength, &length, &size, &type, &name[0]);
+            std::string uniform = name.substr(0, length);
+
+            GLint location = glGetUniformLocation(programID, uniform.c_str());
+            if (location < 0) continue; // block members have no location
+            m_uniforms[uniform] = location;
+
+            // Arrays report only "name[0]"; register the bare name and every element
+            size_t bracket = uniform.rfind("[0]");
+            if (bracket == std::string::npos || bracket + 3 != uniform.size()) continue;
+            std::string base = uniform.substr(0, bracket);
+            m_uniforms[base] = location;
+            for (GLint e = 1; e < size; e++) {
+                std::string element = base + "[" + std::to_string(e) + "]";
+                m_uniforms[element] = glGetUniformLocation(programID, element.c_str());
+            }
+        }
+
+        // Uniform blocks (bound to fixed binding points by the caller)
+        GLint blockCount = 0;
+        glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &blockCount);
+        for (GLint i = 0; i < blockCount; i++) {
+            GLint length = 0;
+            glGetActiveUniformBlockiv(programID, i, GL_UNIFORM_BLOCK_NAME_LENGTH, &length);
+            std::string block(length, '\0');
+            glGetActiveUniformBlockName(programID, i, length, nullptr, &block[0]);
+            block.resize(length > 0 ? length - 1 : 0); // drop the null terminator
+            m_blocks[block] = i;
+        }
+    }
+
+    // Binds a uniform block to a buffer binding point; no-op if the block is inactive
+    void bindBlock(const std::string &name, GLuint binding) const{
+        auto it = m_blocks.find(name);
+        if (it != m_blocks.end()) glUniformBlockBinding(m_program, it->second, binding);
+    }
+
+    GLuint program() const { return m_program; }
+
+    // Location of an active uniform, or -1 if the linker removed it
+    GLint uniform(const std::string &name) const{
+        auto it = m_uniforms.find(name);
+        return it == m_uniforms.end() ? -1 : it->second;
+    }
+
+private:
+    GLuint m_program = 0;
+    std::unordered_map<std::string, GLint> m_uniforms;
+    std::unordered_map<std::string, GLuint> m_blocks;
+};
+
+// Preprocessor symbols injected after #version, each "NAME" or "NAME VALUE"
+using ShaderDefines = std::vector<std::string>;
+
+// One stage's final GLSL, as handed to glShaderSource
+struct ShaderSource{
+    GLenum type;
+    std::string code;
+};
+
+// A program handed to the driver but not yet checked (see beginShaderProgram)
+struct PendingProgram{
+    GLuint program = 0;
+    uint64_t key = 0;
+    std::vector<GLuint> shaders;   // empty when restored from the binary cache
+};
 
 class ShaderLoader{
 public:
-    static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path){
-        // Create and compile the shaders.
-        GLuint vertexShaderID = createShader(GL_VERTEX_SHADER, vertex_file_path);
-        GLuint fragmentShaderID = createShader(GL_FRAGMENT_SHADER, fragment_file_path);
+    static GLuint createShaderProgram(const char * vertex_file_path, const char * fragment_file_path,
+                                      ShaderReflection *reflection = nullptr, const ShaderDefines &defines = {}){
+        return createShaderProgramFromSource({
+            { GL_VERTEX_SHADER,   loadSource(vertex_file_path, defines) },
+            { GL_FRAGMENT_SHADER, loadSource(fragment_file_path, defines) },
+        }, reflection);
+    }
+
+    // Same, with a geometry stage between the vertex and fragment shaders
+    static GLuint createShaderProgram(const char * vertex_file_path, const char * geometry_file_path,
+                                      const char * fragment_file_path, ShaderReflection *reflection = nullptr,
+                                      const ShaderDefines &defines = {}){
+        return createShaderProgramFromSource({
+            { GL_VERTEX_SHADER,   loadSource(vertex_file_path, defines) },
+            { GL_GEOMETRY_SHADER, loadSource(geometry_file_path, defines) },
+            { GL_FRAGMENT_SHADER, loadSource(fragment_file_path, defines) },
+        }, reflection);
+    }
+
+    // Builds a program from in-memory stages. The linked binary is restored
+    // from ProgramBinaryCache when this exact source was built before on the
+    // same driver, and compiled (then stored) otherwise.
+    static GLuint createShaderProgramFromSource(const std::vector<ShaderSource> &stages,
+                                                ShaderReflection *reflection = nullptr){
+        PendingProgram pending = beginShaderProgram(stages);
+        return finishShaderProgram(pending, reflection);
+    }
+
+    // Reads a shader file, expanding #include directives and injecting defines
+    static std::string loadSource(const char *filepath, const ShaderDefines &defines = {}){
+        return injectDefines(readSource(QString(filepath), 0), defines);
+    }
+
+    // Lets the driver compile and link on its own threads, so that
+    // beginShaderProgram returns at once and isComplete can be polled.
+    // Without GL_KHR/ARB_parallel_shader_compile the driver may still
+    // defer work, but isComplete always reports true.
+    static void enableParallelCompile(){
+        if (GLEW_KHR_parallel_shader_compile)      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        else if (GLEW_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+
+    // Restores the program from the binary cache or submits every stage and
+    // the link without querying any status, so nothing waits on the compiler
+    static PendingProgram beginShaderProgram(const std::vector<ShaderSource> &stages){
+        std::string keySource;
+        for (const ShaderSource &stage : stages) keySource += std::to_string(stage.type) + '\n' + stage.code;
+
+        PendingProgram pending;
+        pending.key = ProgramBinaryCache::key(keySource);
+        pending.program = ProgramBinaryCache::load(pending.key);
+        if (pending.program != 0) return pending;
+
+        pending.program = glCreateProgram();
+        for (const ShaderSource &stage : stages) {
+            GLuint shaderID = glCreateShader(stage.type);
+            const char *codePtr = stage.code.c_str();
+            glShaderSource(shaderID, 1, &codePtr, nullptr); // Assumes code is null terminated
+            glCompileShader(shaderID);
+            glAttachShader(pending.program, shaderID);
+            pending.shaders.push_back(shaderID);
+        }
+
+        // Keep the binary retrievable for the cache
+        glProgramParameteri(pending.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        glLinkProgram(pending.program);
+        return pending;
+    }
+
+    // True once finishShaderProgram would not block on the driver
+    static bool isComplete(const PendingProgram &pending){
+        if (pending.shaders.empty()) return true;
+        if (!GLEW_KHR_parallel_shader_compile && !GLEW_ARB_parallel_shader_compile) return true;
+
+        GLint done = GL_FALSE;
+        glGetProgramiv(pending.program, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+
+    // Checks the compile and link results (throwing std::runtime_error with
+    // the info log, after deleting everything, on failure), stores a freshly
+    // linked binary and enumerates the uniforms
+    static GLuint finishShaderProgram(PendingProgram &pending, ShaderReflection *reflection = nullptr){
+        if (!pending.shaders.empty()) {
+            try {
+                for (GLuint shaderID : pending.shaders) checkShader(shaderID);
+                checkProgram(pending.program);
+            } catch (const std::runtime_error &) {
+                discard(pending);
+                throw;
+            }
+
+            // Shaders no longer necessary, stored in program
+            for (GLuint shaderID : pending.shaders) glDeleteShader(shaderID);
+            pending.shaders.clear();
+
+            ProgramBinaryCache::store(pending.key, pending.program);
+        }
+
+        // Enumerate active uniforms once, while the program is fresh
+        if (reflection) reflection->build(pending.program);
 
-        // Link the shader program.
-        GLuint programID = glCreateProgram();
-        glAttachShader(programID, vertexShaderID);
-        glAttachShader(programID, fragmentShaderID);
-        glLinkProgram(programID);
+        return pending.program;
+    }
+
+    // Deletes a program that will never be finished
+    static void discard(PendingProgram &pending){
+        for (GLuint shaderID : pending.shaders) glDeleteShader(shaderID);
+        if (pending.program) glDeleteProgram(pending.program);
+        pending = PendingProgram();
+    }
 
+private:
+    static void checkProgram(GLuint programID){
         // Print the info log if error
         GLint status;
         glGetProgramiv(programID, GL_LINK_STATUS, &status);
@@ -32,38 +226,11 @@ public:
 
             std::string log(length, '\0');
             glGetProgramInfoLog(programID, length, nullptr, &log[0]);
-
-            glDeleteProgram(programID);
             throw std::runtime_error(log);
         }
-
-        // Shaders no longer necessary, stored in program
-        glDeleteShader(vertexShaderID);
-        glDeleteShader(fragmentShaderID);
-
-        return programID;
     }
 
-private:
-    static GLuint createShader(GLenum shaderType, const char *filepath){
-        GLuint shaderID = glCreateShader(shaderType);
-
-        // Read shader file.
-        std::string code;
-        QString filepathStr = QString(filepath);
-        QFile file(filepathStr);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            QTextStream stream(&file);
-            code = stream.readAll().toStdString();
-        }else{
-            throw std::runtime_error(std::string("Failed to open shader: ")+filepath);
-        }
-
-        // Compile shader code.
-        const char *codePtr = code.c_str();
-        glShaderSource(shaderID, 1, &codePtr, nullptr); // Assumes code is null terminated
-        glCompileShader(shaderID);
-
+    static void checkShader(GLuint shaderID){
         // Print info log if shader fails to compile.
         GLint status;
         glGetShaderiv(shaderID, GL_COMPILE_STATUS, &status);
@@ -74,11 +241,52 @@ private:
 
             std::string log(length, '\0');
             glGetShaderInfoLog(shaderID, length, nullptr, &log[0]);
-
-            glDeleteShader(shaderID);
             throw std::runtime_error(log);
         }
+    }
+
+    // Reads a shader file and splices in every line of the form
+    // #include "name", resolved next to the including file. Included
+    // files carry no #version and may include others.
+    static std::string readSource(const QString &filepath, int depth){
+        if (depth > 8) throw std::runtime_error("Shader includes nested too deeply: " + filepath.toStdString());
+
+        QFile file(filepath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            throw std::runtime_error("Failed to open shader: " + filepath.toStdString());
+        }
+
+        const QString directory = QFileInfo(filepath).path();
+        std::string code;
+        QTextStream stream(&file);
+        while (!stream.atEnd()) {
+            QString line = stream.readLine();
+            QString trimmed = line.trimmed();
+            if (trimmed.startsWith("#include")) {
+                int open = trimmed.indexOf('"');
+                int close = trimmed.lastIndexOf('"');
+                if (open < 0 || close <= open) {
+                    throw std::runtime_error("Malformed #include in " + filepath.toStdString());
+                }
+                code += readSource(directory + "/" + trimmed.mid(open + 1, close - open - 1), depth + 1);
+                continue;
+            }
+            code += line.toStdString();
+            code += '\n';
+        }
+        return code;
+    }
+
+    // Inserts one #define per entry right after the #version line
+    static std::string injectDefines(const std::string &code, const ShaderDefines &defines){
+        if (defines.empty()) return code;
+
+        std::string block;
+        for (const std::string &define : defines) block += "#define " + define + "\n";
 
-        return shaderID;
+        // readSource ends every line with '\n'
+        size_t version = code.find("#version");
+        size_t insert = version == std::string::npos ? 0 : code.find('\n', version) + 1;
+        return code.substr(0, insert) + block + code.substr(insert);
     }
 };
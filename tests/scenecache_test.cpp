@@ -0,0 +1,88 @@
+#include "utils/scenecache.h"
+#include "utils/sceneparser.h"
+
+#include <QStandardPaths>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+// ---------------------------------------------------------------------------
+// SceneCache regression test: a snapshot must go stale when any file the
+// parse read changes, including a material library the OBJ pulls in.
+// ---------------------------------------------------------------------------
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+    if (!condition) {
+        std::cerr << "FAILED: " << what << std::endl;
+        failures++;
+    }
+}
+
+void write(const fs::path &path, const std::string &text) {
+    std::ofstream(path, std::ios::trunc) << text;
+}
+
+const char *SCENE = R"({
+  "globalData": { "ambientCoeff": 0.5, "diffuseCoeff": 0.5, "specularCoeff": 0.5, "transparentCoeff": 0 },
+  "cameraData": { "position": [0, 0, 3], "up": [0, 1, 0], "heightAngle": 45.0, "focus": [0, 0, 0] },
+  "groups": [ { "primitives": [ { "type": "mesh", "meshFile": "triangle.obj" } ] } ]
+})";
+
+const char *MESH =
+    "mtllib triangle.mtl\n"
+    "v 0 0 0\nv 1 0 0\nv 0 1 0\n"
+    "usemtl paint\n"
+    "f 1 2 3\n";
+
+glm::vec4 diffuse(const RenderData &data) {
+    if (data.shapes.empty() || data.shapes[0].submeshes.empty()) return glm::vec4(-1.f);
+    return data.shapes[0].submeshes[0].material.cDiffuse;
+}
+
+} // namespace
+
+int main() {
+    // Keep snapshots out of the real user cache
+    QStandardPaths::setTestModeEnabled(true);
+
+    std::error_code ec;
+    const fs::path dir = fs::temp_directory_path() / "scenecache_test";
+    fs::remove_all(dir, ec);
+    fs::create_directories(dir);
+
+    const std::string scene = (dir / "scene.json").string();
+    write(dir / "scene.json", SCENE);
+    write(dir / "triangle.obj", MESH);
+    write(dir / "triangle.mtl", "newmtl paint\nKd 1 0 0\n");
+
+    RenderData parsed;
+    check(SceneParser::parse(scene, parsed), "scene parses");
+    check(parsed.materialLibraries.size() == 1, "parse reports the material library");
+    check(diffuse(parsed) == glm::vec4(1, 0, 0, 1), "submesh takes the MTL diffuse");
+
+    RenderData cached;
+    check(SceneCache::load(scene, cached), "unchanged sources hit the cache");
+    check(diffuse(cached) == glm::vec4(1, 0, 0, 1), "cached submesh keeps the MTL diffuse");
+
+    // Edit only the material library; the scene file and OBJ stay as they were
+    write(dir / "triangle.mtl", "newmtl paint\nKd 0 0 1\n# edited\n");
+
+    RenderData stale;
+    check(!SceneCache::load(scene, stale), "an edited .mtl misses the cache");
+
+    RenderData reparsed;
+    check(SceneParser::parse(scene, reparsed), "scene re-parses");
+    check(diffuse(reparsed) == glm::vec4(0, 0, 1, 1), "re-parse picks up the edited MTL");
+
+    fs::remove_all(dir, ec);
+
+    if (failures == 0) std::cout << "scenecache_test passed" << std::endl;
+    return failures == 0 ? 0 : 1;
+}